@@ -0,0 +1,94 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+enum buffer_size {
+	BUFFER_INITIAL_SIZE = 1024,
+	BUFFER_READ_CHUNK = 1024 * 64
+};
+
+// Builtins write to at most their output and error fds at the same time,
+// CAPTURED_FD is not a real fd, its output only goes to a captured buffer
+enum buffered_output {
+	MAX_BUFFERED_FDS = 4,
+	CAPTURED_FD = -2
+};
+
+// Length tracked byte buffer, always kept '\0' terminated so it can still
+// be used as a string. data may contain '\0' bytes before len.
+typedef struct Buffer {
+	char *data;
+	size_t len;
+	size_t size;
+} Buffer;
+
+Buffer *new_buffer();
+void reset_buffer(Buffer *buffer);
+void free_buffer(Buffer *buffer);
+
+/**
+ * @brief Makes sure there is room for at least extra bytes plus the '\0'
+ * 
+ * @param buffer 
+ * @param extra 
+ * @return 0 on success | -1 if the buffer can not grow
+ */
+int grow_buffer(Buffer *buffer, size_t extra);
+int append_buffer(Buffer *buffer, const char *data, size_t len);
+
+/**
+ * @brief Reads fd until EOF appending everything to buffer
+ * 
+ * @param buffer 
+ * @param fd 
+ * @return Number of bytes read | -1 on error
+ */
+ssize_t read_to_buffer(Buffer *buffer, int fd);
+
+// Removes one trailing '\n' if present
+void chomp_buffer(Buffer *buffer);
+
+// Buffered output of builtins
+
+/**
+ * @brief Same as dprintf, but the output is kept until flush_buffered so a
+ * builtin makes a single write() for each fd
+ * 
+ * @param fd 
+ * @param format 
+ * @return Number of bytes buffered | -1 on error
+ */
+int dprintf_buffered(int fd, const char *format, ...);
+int write_buffered(int fd, const char *data, size_t len);
+
+/**
+ * @brief Writes everything buffered for every fd, called once a builtin
+ * finishes
+ * 
+ * @return 0 on success | -1 if a write failed
+ */
+int flush_buffered();
+
+/**
+ * @brief Buffered output to fd is appended to buffer instead of being
+ * written, until end_capture_buffered
+ * 
+ * @param fd 
+ * @param buffer 
+ */
+void capture_buffered(int fd, Buffer *buffer);
+
+/**
+ * @brief Stops every capture, the captured buffers are left as they are
+ */
+void end_capture_buffered();
@@ -14,25 +14,37 @@
 
 enum {
 	LINE_SIZE = 1024,	// In bytes
-	ALIAS_MAX = 256,
-	ALIAS_MAX_COMMAND = 64,	// In bytes
-	ALIAS_MAX_REFERENCE = 128	// In bytes
+	ALIAS_INITIAL_SIZE = 64	// Power of 2
 };
 
-extern struct alias *aliases[ALIAS_MAX];
 extern char *alias_use;
 extern char *alias_description;
 extern char *alias_help;
+extern char *unalias_use;
+extern char *unalias_description;
+extern char *unalias_help;
 
 struct alias {
-	char command[ALIAS_MAX_COMMAND];
-	char reference[ALIAS_MAX_REFERENCE];
+	char *command;
+	char *reference;
+	// Words of a reference without special characters, split when the
+	// alias is defined. NULL if the reference has to be parsed.
+	char **words;
+	int n_words;
+	// Set while the alias is expanded, so it is not expanded again
+	int is_expanding;
+	unsigned int hash;
 };
 
-struct alias *new_alias(const char *command, char *reference);
-
 int alias(int argc, char *argv[], int stdout_fd, int stderr_fd);
+int unalias(int argc, char *argv[], int stdout_fd, int stderr_fd);
 
 int add_alias(char *command);
+void set_alias(const char *name, const char *value);
+int remove_alias(const char *name);
 char *get_alias(const char *name);
+struct alias *find_alias(const char *name);
+// Starting with index 0, returns every alias and then NULL
+struct alias *next_alias(size_t *index);
 void print_aliases();
+void free_aliases();
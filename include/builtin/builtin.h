@@ -35,5 +35,16 @@ int modify_cmd_builtin(Command * modify_command);
 int has_builtin_exec_in_shell(Command * command);
 int exec_builtin_in_shell(Command * command, int is_pipe);
 
+/**
+ * @brief Executes output only builtins inside $() without forking, writing
+ * directly to the substitution buffer
+ * 
+ * @param command 
+ * @return 1 = Can be executed in the shell | 0 = Need to fork
+ */
+int has_builtin_exec_in_buffer(Command * command);
+int exec_builtin_in_buffer(Command * command);
+int is_builtin_in_buffer(char *name);
+
 int find_builtin(Command * command);
 void exec_builtin(Command * start_scommand, Command * command);
@@ -12,9 +12,15 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+struct Buffer;
+struct Multio;
+
 enum {
 	MAX_ARGUMENT_SIZE = 1024,
-	MAX_ARGUMENTS = 128
+	MAX_ARGUMENTS = 128,
+	MAX_EXTRA_OUTPUTS = 16,
+	MAX_REDIRECTIONS = 16,
+	COMMAND_POOL_SIZE = 4
 };
 
 enum wait {
@@ -40,16 +46,44 @@ enum search_cmd {
 	SEARCH_CMD_ONLY_BUILTIN
 };
 
+enum array_assignment {
+	NO_ARRAY_ASSIGNMENT,
+	// name=( was found, the elements are the next arguments
+	ARRAY_ASSIGNMENT_OPEN,
+	ARRAY_ASSIGNMENT_CLOSED
+};
+
+enum redirection_type {
+	REDIRECT_FILE,
+	// Duplicate of a std fd before its file redirections
+	REDIRECT_DUP,
+	REDIRECT_CLOSE
+};
+
+// Redirections of fds other than the std files in input, output and
+// err_output, at most one for each fd
+typedef struct Redirection {
+	int fd;
+	int type;
+	int source;
+} Redirection;
+
 typedef struct Command {
 	char argv[MAX_ARGUMENTS][MAX_ARGUMENT_SIZE];
+	// Every field from argc on is zeroed when the command is cleared
 	int argc;
+	// Highest argc reached, the argv after it were never written
+	int max_argc;
 	char *current_arg;
 	pid_t pid;
 	int search_location;
+	int array_assignment;
 	// Only used for the first command in pipe
 	int next_status_needed_to_exec;
 	// Execute in background Only in first command in pipe
 	int do_wait;
+	// Environment snapshot taken before forking, only in first command
+	char **envp;
 	// Pipes
 	int input;
 	int output;
@@ -57,8 +91,14 @@ typedef struct Command {
 	int fd_pipe_input[2];
 	int fd_pipe_output[2];
 	struct Command *pipe_next;
+	// Every > after the first one, the outputs are copied by a multio
+	int extra_output[MAX_EXTRA_OUTPUTS];
+	int n_extra_outputs;
+	struct Multio *multio;
+	Redirection redirections[MAX_REDIRECTIONS];
+	int n_redirections;
 	// Only used when $()
-	char *output_buffer;
+	struct Buffer *output_buffer;
 } Command;
 
 // Builtin command
@@ -77,15 +117,28 @@ void reset_command(Command *command);
 void free_command(Command *command);
 void free_command_with_buf(Command *command);
 
-int check_alias_cmd(Command *command);
-
 int add_arg(Command *command);
 
 int reset_last_arg(Command *command);
 
 int set_file_cmd(Command *command, int file_type, char *file);
 
-int set_buffer_cmd(Command *command, char *buffer);
+/**
+ * @brief Redirects fd of the command, word is a file or for DUPLICATE_FD
+ * another fd or - to close it
+ * 
+ * @param command 
+ * @param fd 
+ * @param file_type 
+ * @param word 
+ * @return New file descriptor | -1 on error
+ */
+int set_fd_cmd(Command *command, int fd, int file_type, char *word);
+
+// File descriptor the shell has to use as fd when running it in the shell
+int get_fd_cmd(Command *command, int fd);
+
+int set_buffer_cmd(Command *command, struct Buffer *buffer);
 
 int set_to_background_cmd(Command *command);
 
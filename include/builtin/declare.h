@@ -0,0 +1,25 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+extern char *declare_use;
+extern char *declare_description;
+extern char *declare_help;
+
+/**
+ * @brief Sets variables with attributes, -a makes them arrays, -i stores
+ * them as integers and -x exports them
+ * 
+ * @return EXIT_SUCCESS | EXIT_FAILURE
+ */
+int declare(int argc, char *argv[], int stdout_fd, int stderr_fd);
@@ -16,4 +16,4 @@ extern char *echo_use;
 extern char *echo_description;
 extern char *echo_help;
 
-int echo(int argc, char *argv[]);
+int echo(int argc, char *argv[], int stdout_fd, int stderr_fd);
@@ -0,0 +1,37 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+extern char *exec_use;
+extern char *exec_description;
+extern char *exec_help;
+
+/**
+ * @brief Applies the redirections of the command to the shell itself, so
+ * every later command inherits them. With arguments the shell is replaced by
+ * that command
+ * 
+ * @param command 
+ * @return EXIT_SUCCESS | EXIT_FAILURE
+ */
+int mash_exec(Command * command, int argc, char *argv[], int stdout_fd,
+	      int stderr_fd);
+
+/**
+ * @brief Fds opened with exec belong to the shell, the close_all_fd helpers
+ * leave them open
+ * 
+ * @param fd 
+ * @return 1 if fd was opened with exec | 0 otherwise
+ */
+int is_shell_fd(int fd);
@@ -0,0 +1,29 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+extern char *mapfile_use;
+extern char *mapfile_description;
+extern char *mapfile_help;
+extern char *readarray_use;
+extern char *readarray_description;
+extern char *readarray_help;
+
+/**
+ * @brief Loads every line of stdin_fd into an array with a single read of
+ * the whole input, the lines are kept in one block
+ * 
+ * @return EXIT_SUCCESS | EXIT_FAILURE
+ */
+int mapfile(int argc, char *argv[], int stdin_fd, int stdout_fd,
+	    int stderr_fd);
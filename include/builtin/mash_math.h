@@ -16,4 +16,15 @@ extern char *math_use;
 extern char *math_description;
 extern char *math_help;
 
-int math(int argc, char *argv[]);
+int math(int argc, char *argv[], int stdout_fd, int stderr_fd);
+
+/**
+ * @brief Evaluates an arithmetic expression, integer variables are used
+ * directly
+ * 
+ * @param expression 
+ * @param result 
+ * @param error_fd 
+ * @return 0 on success | -1 if the expression is not valid
+ */
+int eval_math(char *expression, long long *result, int error_fd);
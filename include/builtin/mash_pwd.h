@@ -16,4 +16,4 @@ extern char *pwd_use;
 extern char *pwd_description;
 extern char *pwd_help;
 
-int pwd(int argc, char *argv[]);
+int pwd(int argc, char *argv[], int stdout_fd, int stderr_fd);
@@ -13,12 +13,7 @@
 // limitations under the License.
 
 enum {
-	MAX_SOURCE_FILES = 64,	// In bytes
-	MAX_FILE_LENGTH = 256	// In bytes
-};
-
-struct source_file {
-	char file[MAX_FILE_LENGTH];
+	SOURCED_INITIAL_SIZE = 16
 };
 
 extern char *source_use;
@@ -27,16 +22,26 @@ extern char *source_help;
 
 int source(int argc, char *argv[], int stdout_fd, int stderr_fd);
 
-struct source_file *new_source_file(char *source_file_name);
+int exec_source(const char *source_file_name, int once, int error_fd);
 
-void free_source_file();
+// Starting with index 0, returns the path of every file sourced and then NULL
+const char *next_sourced_path(size_t *index);
 
-int add_source(char *source_file_name, int error_fd);
-
-int exec_sources();
+void free_sources();
 
 int read_source_file(char *filename);
 
-int find_path_srcfile(char *filename);
+/**
+ * @brief Reads the next line like fgets does, from the script being run or
+ * from stdin when there is none. Continuation lines and here documents are
+ * taken from the same script as the command.
+ * 
+ * @param line 
+ * @param size 
+ * @return line | NULL at the end of the script or of stdin
+ */
+char *read_script_line(char *line, int size);
+
+char *find_path_srcfile(const char *filename);
 
-int file_exists(char *path);
+int file_exists(const char *path);
@@ -31,7 +31,14 @@ void write_to_buffer(Command * last_command);
 // Redirect input and output: Child
 void redirect_stdin(Command * command, Command * start_command);
 void redirect_stdout(Command * command);
-void redirect_stderr(Command * command);
+
+/**
+ * @brief Applies every file redirection of the command in a single ordered
+ * pass, after the pipes
+ * 
+ * @param command 
+ */
+void redirect_fds(Command * command);
 
 // File descriptor
 int set_input_shell_pipe(Command * command);
@@ -42,3 +49,4 @@ int close_all_fd(Command * start_command);
 int close_all_fd_no_fork(Command * start_command);
 int close_all_fd_io(Command * start_command, Command * last_command);
 int close_all_fd_cmd(Command * command, Command * start_command);
+int close_redirections(Command * command);
@@ -13,7 +13,6 @@
 // limitations under the License.
 
 typedef struct SubInfo {
-	char last_alias[ALIAS_MAX_COMMAND];
 	char *old_ptr;
 	char buffer[MAX_ARGUMENT_SIZE];
 	 spec_char(*old_lexer)[ASCII_CHARS];
@@ -24,6 +23,7 @@ void restore_sub_info(SubInfo *sub_info);
 
 typedef struct FileInfo {
 	int mode;
+	int fd;
 	char *ptr;
 	char buffer[MAX_ARGUMENT_SIZE];
 } FileInfo;
@@ -17,6 +17,9 @@ extern int writing_to_file;
 extern char flags[3];
 extern char version[32];
 
+// Exit status of the last command, $? is only formatted when expanded
+extern int last_status;
+
 int set_arguments(char *argv[]);
 int init_mash();
 
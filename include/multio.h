@@ -0,0 +1,47 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+enum multio {
+	MAX_MULTIO_OUTPUTS = MAX_EXTRA_OUTPUTS + 2,
+	MULTIO_CHUNK = 1024 * 64
+};
+
+// Copies a command stdout to several outputs from a shell thread
+typedef struct Multio {
+	int input;
+	int outputs[MAX_MULTIO_OUTPUTS];
+	int n_outputs;
+	int has_thread;
+	int refs;
+	pthread_t thread;
+} Multio;
+
+/**
+ * @brief Creates the multio of every command in the pipe with more than one
+ * output, the command output becomes the multio pipe. Call before forking
+ * 
+ * @param start_command 
+ */
+void prepare_multio(Command *start_command);
+
+// Call after forking
+void start_multio(Command *start_command);
+
+/**
+ * @brief Waits for the multio threads if join, else they finish on their own
+ * 
+ * @param start_command 
+ * @param join 
+ */
+void end_multio(Command *start_command, int join);
@@ -16,9 +16,13 @@ enum read_mode {
 	NO_FILE_READ,
 	HERE_DOC_READ,
 	INPUT_READ,
+	HERE_STRING_READ,
+	READ_WRITE,
 	OUTPUT_WRITE,
-	ERROR_WRITE,
-	ERROR_AND_OUTPUT_WRITE
+	APPEND_WRITE,
+	ERROR_AND_OUTPUT_WRITE,
+	ERROR_AND_OUTPUT_APPEND,
+	DUPLICATE_FD
 };
 
 enum here_doc {
@@ -26,7 +30,35 @@ enum here_doc {
 	MAX_HERE_DOC_BUFFER = 1024 * 64
 };
 
+// Scripts can only use fds below this with exec, the shell keeps the files
+// it holds open itself above it
+enum shell_fds {
+	MAX_SHELL_FDS = 10
+};
+
 extern int open_read_file(char *filename);
 extern int open_write_file(char *filename);
+extern int open_append_file(char *filename);
+extern int open_read_write_file(char *filename);
+extern int open_file(char *filename, int flags);
+
+/**
+ * @brief Opens a file the shell reads itself, moved above the fds a script
+ * can redirect with exec
+ * 
+ * @param filename 
+ * @return File descriptor | -1 on error
+ */
+extern int open_shell_file(char *filename);
+
+/**
+ * @brief Opens a pipe to read str followed by a newline. Like any other
+ * word, a here string is at most MAX_ARGUMENT_SIZE - 1 bytes, longer
+ * expansions are cut when they are pasted into the word
+ * 
+ * @param str 
+ * @return File descriptor | -1 on error
+ */
+extern int open_here_string(char *str);
 
 extern char *new_here_doc_buffer();
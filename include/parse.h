@@ -13,6 +13,7 @@
 // limitations under the License.
 
 extern int syntax_mode;
+extern int concurrent_subexec;
 
 enum syntax_mode {
 	BASIC_SYNTAX,
@@ -23,6 +24,38 @@ enum ascii {
 	ASCII_CHARS = 256
 };
 
+enum concurrent_subexec {
+	MAX_CONCURRENT_SUBEXEC = 32
+};
+
+enum process_sub {
+	MAX_PROCESS_SUBS = 32
+};
+
+// ${name<operator>word}
+enum brace_operator {
+	BRACE_NONE,
+	// # and ##
+	BRACE_PREFIX,
+	BRACE_LONGEST_PREFIX,
+	// % and %%
+	BRACE_SUFFIX,
+	BRACE_LONGEST_SUFFIX,
+	// /, //, /# and /%
+	BRACE_REPLACE,
+	BRACE_REPLACE_ALL,
+	BRACE_REPLACE_PREFIX,
+	BRACE_REPLACE_SUFFIX,
+	// :offset:length
+	BRACE_SUBSTRING,
+	// :-
+	BRACE_DEFAULT
+};
+
+enum redirection_fd {
+	MAX_FD_DIGITS = 4
+};
+
 struct ExecInfo;
 
 typedef char *(*spec_char)(char *, struct ExecInfo *);
@@ -44,3 +77,16 @@ ParseInfo *new_parse_info();
 void restore_parse_info(ParseInfo *parse_info);
 
 char *parse(char *line, struct ExecInfo *exec_info);
+
+/**
+ * @brief Launches at the same time every $() of the next command in line,
+ * their output is then picked in order while parsing it
+ * 
+ * @param line 
+ * @return Number of command substitutions launched
+ */
+int start_concurrent_subexecs(char *line);
+void end_concurrent_subexecs();
+
+// Closes the shell side of the <() and >() once their command is launched
+void end_process_subs();
@@ -12,5 +12,19 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-int find_command(char *line, char *buffer, FILE * src_file,
+struct Buffer;
+
+int find_command(char *line, struct Buffer *buffer, FILE * src_file,
 		 ExecInfo * prev_exec_info, char *to_free_excess);
+
+/**
+ * @brief Runs a command that is already split in words, like find_command
+ * does with a line without expansions, quotes, redirections or operators
+ * 
+ * @param line Buffer of MAX_ARGUMENT_SIZE, it is cleared like in find_command
+ * @param words 
+ * @param n_words 
+ * @param src_file 
+ * @return Status of the command
+ */
+int exec_words(char *line, char **words, int n_words, FILE * src_file);
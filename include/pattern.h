@@ -0,0 +1,86 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+enum pattern_cache {
+	PATTERN_CACHE_SIZE = 32
+};
+
+enum pattern_token_type {
+	PATTERN_CHAR,
+	// ?
+	PATTERN_ANY_CHAR,
+	// *
+	PATTERN_ANY_STRING,
+	// [...]
+	PATTERN_CLASS
+};
+
+typedef struct PatternToken {
+	int type;
+	char c;
+	// Only PATTERN_CLASS, one bit for each byte
+	unsigned char set[32];
+} PatternToken;
+
+// Glob pattern already split in tokens, \ escapes are resolved
+typedef struct Pattern {
+	char *source;
+	PatternToken *tokens;
+	size_t n_tokens;
+	int has_wildcards;
+	// Without wildcards the pattern is compared as this string
+	char *literal;
+} Pattern;
+
+/**
+ * @brief Compiles a glob pattern, the last ones compiled are cached so
+ * the same pattern is only compiled once. The pattern belongs to the cache
+ * 
+ * @param source 
+ * @return Compiled pattern
+ */
+Pattern *get_pattern(const char *source);
+
+/**
+ * @brief Checks if the len bytes of str match the whole pattern
+ * 
+ * @param pattern 
+ * @param str 
+ * @param len 
+ * @return 1 if they match | 0 otherwise
+ */
+int match_pattern(Pattern *pattern, const char *str, size_t len);
+
+/**
+ * @brief Length of the prefix or suffix of str that matches pattern
+ * 
+ * @param pattern 
+ * @param str 
+ * @param from_end Match a suffix instead of a prefix
+ * @param longest Longest match instead of the shortest one
+ * @return Length of the match | -1 if nothing matches
+ */
+long match_affix(Pattern *pattern, const char *str, int from_end,
+		 int longest);
+
+/**
+ * @brief Finds the first substring of str that matches pattern, the
+ * longest one starting there
+ * 
+ * @param pattern 
+ * @param str 
+ * @param len Length of the match
+ * @return Start of the match | NULL if nothing matches
+ */
+const char *find_pattern(Pattern *pattern, const char *str, size_t *len);
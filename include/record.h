@@ -0,0 +1,53 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Records of the files mash saves for later runs, every integer is in the
+// byte order of the machine and every string is followed by '\0' so it can
+// be used from a map. Appending only fails if there is no memory left,
+// which is fatal.
+
+void put_bytes(Buffer *buffer, const void *data, size_t len);
+void put_u32(Buffer *buffer, uint32_t value);
+void put_u64(Buffer *buffer, uint64_t value);
+
+/**
+ * @brief Appends the length of str, then str and its '\0'
+ * 
+ * @param buffer 
+ * @param str 
+ * @param len 
+ */
+void put_string(Buffer *buffer, const char *str, size_t len);
+
+/**
+ * @brief Reads a value and moves ptr past it
+ * 
+ * @param ptr 
+ * @param end 
+ * @param value 
+ * @return 1 on success | 0 if the data ends before the value
+ */
+int get_u32(const char **ptr, const char *end, uint32_t *value);
+int get_u64(const char **ptr, const char *end, uint64_t *value);
+
+/**
+ * @brief Reads a string of len bytes and its '\0' and moves ptr past it
+ * 
+ * @param ptr 
+ * @param end 
+ * @param len 
+ * @return The string | NULL if it is not complete or not '\0' terminated
+ */
+const char *get_string(const char **ptr, const char *end, uint32_t len);
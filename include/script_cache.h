@@ -0,0 +1,100 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// File format, every integer is in the byte order of the machine:
+//   magic, version length and version of mash
+//   dev, inode, size, mtime seconds and ns of the script
+//   lines: kind, text length, text, number of words, then the length of
+//          each word and the word
+// Every string is followed by '\0' so it can be used from the map. Lines
+// are split like fgets does with MAX_ARGUMENT_SIZE, so continuation lines
+// and here documents can still be read from the records.
+enum script_cache {
+	SCRIPT_CACHE_MAGIC_SIZE = 8
+};
+
+// What is known about a line before running it
+enum script_line_kind {
+	// Only blanks, it does nothing
+	SCRIPT_BLANK,
+	// Starts with #, it is only a comment in the extended syntax
+	SCRIPT_COMMENT,
+	// Words split by blanks without any character the lexer treats as
+	// special, so they are the arguments as they are
+	SCRIPT_WORDS,
+	// Anything else is lexed when it runs
+	SCRIPT_TEXT
+};
+
+typedef struct ScriptLine {
+	int kind;
+	const char *text;
+	uint32_t len;
+	int n_words;
+	char *words[MAX_ARGUMENTS];
+} ScriptLine;
+
+typedef struct CompiledScript {
+	// Records of the lines
+	const char *lines;
+	const char *end;
+	// The cache file when it is mapped
+	void *map;
+	size_t map_size;
+	// The records when the script was just compiled
+	Buffer *buffer;
+} CompiledScript;
+
+// Directory of the cache, NULL when it is not used
+extern char *script_cache_dir;
+
+/**
+ * @brief Maps the compiled script of the file with the stat st, it is only
+ * used if mash and the file are the same as when it was compiled
+ * 
+ * @param script 
+ * @param st 
+ * @return 1 if it was loaded | 0 if it is not in the cache or not valid
+ */
+int load_compiled_script(CompiledScript *script, const struct stat *st);
+
+/**
+ * @brief Compiles the text of a script and saves it in the cache
+ * 
+ * @param script 
+ * @param st 
+ * @param data 
+ * @param size 
+ */
+void compile_script(CompiledScript *script, const struct stat *st,
+		    const char *data, size_t size);
+void free_compiled_script(CompiledScript *script);
+
+/**
+ * @brief Reads the line at ptr and moves ptr to the next one
+ * 
+ * @param ptr 
+ * @param end 
+ * @param line 
+ * @return 1 on success | 0 at the end or if the record is not complete
+ */
+int next_script_line(const char **ptr, const char *end, ScriptLine *line);
+
+/**
+ * @brief Removes every compiled script of the cache directory
+ * 
+ * @return Number of scripts removed | -1 if the directory can not be read
+ */
+int clear_script_cache();
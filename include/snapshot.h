@@ -0,0 +1,46 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// File format, every integer is in the byte order of the machine:
+//   magic, version length and version of mash
+//   number of inherited variables the rc used, the length and name of
+//   each one, hash of their inherited values
+//   number of files, aliases and variables
+//   files:     path length, path, dev, inode, size, mtime seconds and ns
+//   aliases:   name length, value length, name, value
+//   variables: flags, name length, value length, name, value
+// Every string is followed by '\0' so it can be used from the map.
+enum snapshot {
+	SNAPSHOT_MAGIC_SIZE = 8
+};
+
+/**
+ * @brief Restores the aliases and variables of a snapshot, it is only used
+ * when every file it was built from is unchanged and mash inherited the
+ * same values of the variables the rc used
+ * 
+ * @param path 
+ * @return 1 if it was loaded | 0 if it does not exist or is not valid
+ */
+int load_snapshot(const char *path);
+
+/**
+ * @brief Saves the aliases, the variables that are not the same as in the
+ * environment of mash, the files sourced until now and the variables
+ * recorded by track_environment
+ * 
+ * @param path 
+ * @return 0 on success | -1 if it could not be written
+ */
+int save_snapshot(const char *path);
@@ -0,0 +1,233 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+enum variables {
+	VARIABLES_INITIAL_SIZE = 256,	// Power of 2
+	ARRAY_INITIAL_SIZE = 8,
+	TRACKED_NAMES_INITIAL_SIZE = 16
+};
+
+enum variable_flags {
+	VAR_EXPORTED = 1 << 0,
+	// Stored in integer, assignments are evaluated as arithmetic
+	VAR_INTEGER = 1 << 1,
+	// value does not have the last integer yet
+	VAR_STALE_VALUE = 1 << 2,
+	// Indexed array, never exported
+	VAR_ARRAY = 1 << 3,
+	// Came from the environment mash started with
+	VAR_INHERITED = 1 << 4,
+	// Already recorded by track_environment
+	VAR_TRACKED = 1 << 5
+};
+
+enum variable_size {
+	MAX_INTEGER_STRING = 24	// -9223372036854775808 and '\0'
+};
+
+// Elements of an indexed array in a single vector, unset ones are NULL
+typedef struct Array {
+	char **elements;
+	// Last set index + 1
+	size_t len;
+	size_t size;
+	size_t n_set;
+	// Elements loaded at once by load_array are all inside block
+	char *block;
+	size_t block_size;
+} Array;
+
+// Shell variable, only the exported ones are in the environment of commands
+typedef struct Variable {
+	char *name;
+	// NULL for arrays
+	char *value;
+	long long integer;
+	Array *array;
+	unsigned int hash;
+	int flags;
+} Variable;
+
+// Incremented every time the environment of commands changes
+extern unsigned long env_generation;
+// Times get_envp built a new environment or returned the last one
+extern unsigned long envp_rebuilds;
+extern unsigned long envp_reuses;
+
+/**
+ * @brief Creates the variable store with every variable of envp exported
+ * 
+ * @param envp 
+ */
+void init_variables(char **envp);
+
+/**
+ * @brief Looks up a variable in O(1)
+ * 
+ * @param name 
+ * @return Value of the variable | NULL if it does not exist
+ */
+char *get_var(const char *name);
+
+/**
+ * @brief Creates or updates a variable, flags are added to the ones it
+ * already has. The value of an integer variable is an arithmetic expression
+ * 
+ * @param name 
+ * @param value 
+ * @param flags 
+ * @return 0 on success | -1 if name is not valid | -2 if the arithmetic
+ * expression is not valid
+ */
+int set_var(const char *name, const char *value, int flags);
+
+/**
+ * @brief Sets an integer variable, it is only formatted as a string when it
+ * is expanded or exported
+ * 
+ * @param name 
+ * @param value 
+ * @param flags VAR_INTEGER is always added
+ * @return 0 on success | -1 if name is not valid
+ */
+int set_var_int(const char *name, long long value, int flags);
+
+/**
+ * @brief Reads a variable as a number, integer variables are not converted
+ * 
+ * @param name 
+ * @param value 
+ * @return 0 on success | -1 if it does not exist or is not a number
+ */
+int get_var_int(const char *name, long long *value);
+
+/**
+ * @brief Sets a variable from a name=value or name[index]=value assignment
+ * 
+ * @param assignment 
+ * @param flags 
+ * @return 0 on success | -1 if it is not a valid assignment | -2 if the
+ * arithmetic expression is not valid
+ */
+int assign_var(const char *assignment, int flags);
+
+/**
+ * @brief Adds flags to an existing variable
+ * 
+ * @param name 
+ * @param flags 
+ * @return 0 on success | -1 if name is not valid | -2 if the variable does
+ * not exist
+ */
+int set_var_flags(const char *name, int flags);
+
+/**
+ * @brief Replaces every element of an array, a scalar variable becomes an
+ * array
+ * 
+ * @param name 
+ * @param values 
+ * @param n 
+ * @return 0 on success | -1 if name is not valid
+ */
+int set_array(const char *name, char *const *values, size_t n);
+
+/**
+ * @brief Sets a single element, a scalar variable becomes an array with its
+ * value as element 0
+ * 
+ * @param name 
+ * @param index 
+ * @param value 
+ * @return 0 on success | -1 if name is not valid
+ */
+int set_array_element(const char *name, size_t index, const char *value);
+
+/**
+ * @brief Replaces every element of an array with the n strings of elements.
+ * The array takes both elements and block, every element must point inside
+ * block so they are freed with a single free()
+ * 
+ * @param name 
+ * @param block 
+ * @param block_size 
+ * @param elements 
+ * @param n 
+ * @return 0 on success | -1 if name is not valid
+ */
+int load_array(const char *name, char *block, size_t block_size,
+	       char **elements, size_t n);
+
+/**
+ * @brief Elements of an array, a scalar variable is an array of one element
+ * 
+ * @param name 
+ * @param len Last set index + 1, unset elements before it are NULL
+ * @return Elements | NULL if the variable does not exist
+ */
+char *const *get_array(const char *name, size_t *len);
+
+/**
+ * @brief Number of elements set, not the last index
+ * 
+ * @param name 
+ * @return Number of elements | -1 if the variable does not exist
+ */
+long count_array(const char *name);
+
+/**
+ * @brief Evaluates the arithmetic expression of a subscript, negative
+ * indexes count from the end of the array
+ * 
+ * @param name 
+ * @param expression 
+ * @param index 
+ * @return 0 on success | -1 if the expression or the index are not valid
+ */
+int eval_array_index(const char *name, char *expression, size_t *index);
+
+/**
+ * @brief Iterates over the scalar variables, arrays are skipped
+ * 
+ * @param index 0 for the first call, it is updated for the next one
+ * @param name 
+ * @param value 
+ * @param flags 
+ * @return 1 if a variable was returned | 0 if there are no more
+ */
+int next_var(size_t *index, const char **name, const char **value,
+	     int *flags);
+
+/**
+ * @brief While on, records the name of every inherited variable that is
+ * read or assigned and of every unset variable that is read, the
+ * environment something run meanwhile depends on
+ * 
+ * @param on 
+ */
+void track_environment(int on);
+
+// Starting with index 0, returns every name recorded by track_environment
+// and then NULL
+const char *next_tracked_name(size_t *index);
+
+/**
+ * @brief Environment for execve with the exported variables, only rebuilt
+ * when env_generation changed since the last call. A rebuild frees the
+ * previous array and its strings, so a returned environment is only valid
+ * until the next call
+ * 
+ * @return NULL terminated name=value array
+ */
+char **get_envp();
@@ -0,0 +1,326 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "buffer.h"
+
+// DECLARE STATIC FUNCTIONS
+static Buffer *get_fd_buffer(int fd);
+static int write_all(int fd, const char *data, size_t len);
+static void swap_buffered_fds(int i, int j);
+
+// Output of the builtin being executed, one buffer for each fd
+static struct {
+	int fd;
+	Buffer *buffer;
+	// Buffer of someone else that takes the output instead, it is never
+	// written to fd
+	Buffer *captured;
+} buffered_fds[MAX_BUFFERED_FDS];
+static int n_buffered_fds = 0;
+
+Buffer *
+new_buffer()
+{
+	Buffer *buffer = (Buffer *) malloc(sizeof(Buffer));
+
+	// Check if malloc failed
+	if (buffer == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	buffer->data = malloc(BUFFER_INITIAL_SIZE);
+	if (buffer->data == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	buffer->data[0] = '\0';
+	buffer->len = 0;
+	buffer->size = BUFFER_INITIAL_SIZE;
+
+	return buffer;
+}
+
+void
+reset_buffer(Buffer * buffer)
+{
+	buffer->len = 0;
+	buffer->data[0] = '\0';
+}
+
+void
+free_buffer(Buffer * buffer)
+{
+	if (buffer == NULL) {
+		return;
+	}
+	free(buffer->data);
+	free(buffer);
+}
+
+int
+grow_buffer(Buffer * buffer, size_t extra)
+{
+	size_t new_size = buffer->size;
+	char *new_data;
+
+	// Keep one byte for the '\0'
+	if (buffer->len + extra + 1 <= buffer->size) {
+		return 0;
+	}
+	// Grow geometrically so appending n bytes is O(n) overall
+	while (buffer->len + extra + 1 > new_size) {
+		if (new_size > (size_t)-1 / 2) {
+			errno = ENOMEM;
+			return -1;
+		}
+		new_size *= 2;
+	}
+
+	new_data = realloc(buffer->data, new_size);
+	if (new_data == NULL) {
+		return -1;
+	}
+	buffer->data = new_data;
+	buffer->size = new_size;
+	return 0;
+}
+
+int
+append_buffer(Buffer * buffer, const char *data, size_t len)
+{
+	if (grow_buffer(buffer, len) < 0) {
+		return -1;
+	}
+	memcpy(buffer->data + buffer->len, data, len);
+	buffer->len += len;
+	buffer->data[buffer->len] = '\0';
+	return 0;
+}
+
+ssize_t
+read_to_buffer(Buffer * buffer, int fd)
+{
+	ssize_t bytes;
+	ssize_t total = 0;
+	size_t chunk = BUFFER_READ_CHUNK;
+	struct stat st;
+
+	// Regular files are read with a single read() of their size
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+		if (grow_buffer(buffer, st.st_size + 1) < 0) {
+			return -1;
+		}
+		chunk = 1;
+	}
+
+	do {
+		if (grow_buffer(buffer, chunk) < 0) {
+			return -1;
+		}
+		// Read straight into the free space, no intermediate copy
+		bytes = read(fd, buffer->data + buffer->len,
+			     buffer->size - buffer->len - 1);
+		if (bytes > 0) {
+			buffer->len += bytes;
+			total += bytes;
+		} else if (bytes < 0 && errno == EINTR) {
+			bytes = 1;
+		}
+	} while (bytes > 0);
+	buffer->data[buffer->len] = '\0';
+
+	if (bytes < 0) {
+		return -1;
+	}
+	return total;
+}
+
+void
+chomp_buffer(Buffer * buffer)
+{
+	if (buffer->len > 0 && buffer->data[buffer->len - 1] == '\n') {
+		buffer->data[--buffer->len] = '\0';
+	}
+}
+
+int
+dprintf_buffered(int fd, const char *format, ...)
+{
+	Buffer *buffer = get_fd_buffer(fd);
+	va_list ap;
+	int len;
+
+	va_start(ap, format);
+	len = vsnprintf(buffer->data + buffer->len,
+			buffer->size - buffer->len, format, ap);
+	va_end(ap);
+	if (len < 0) {
+		return -1;
+	}
+
+	if ((size_t)len >= buffer->size - buffer->len) {
+		// Did not fit, the output is only complete the second time
+		if (grow_buffer(buffer, len) < 0) {
+			buffer->data[buffer->len] = '\0';
+			flush_buffered();
+			va_start(ap, format);
+			len = vdprintf(fd, format, ap);
+			va_end(ap);
+			return len;
+		}
+		va_start(ap, format);
+		vsnprintf(buffer->data + buffer->len,
+			  buffer->size - buffer->len, format, ap);
+		va_end(ap);
+	}
+	buffer->len += len;
+
+	if (buffer->len >= BUFFER_READ_CHUNK) {
+		flush_buffered();
+	}
+	return len;
+}
+
+int
+write_buffered(int fd, const char *data, size_t len)
+{
+	Buffer *buffer = get_fd_buffer(fd);
+
+	if (append_buffer(buffer, data, len) < 0) {
+		flush_buffered();
+		if (write_all(fd, data, len) < 0) {
+			return -1;
+		}
+	}
+	if (buffer->len >= BUFFER_READ_CHUNK) {
+		flush_buffered();
+	}
+	return len;
+}
+
+int
+flush_buffered()
+{
+	int i;
+	int n_captured = 0;
+	int ret = 0;
+
+	for (i = 0; i < n_buffered_fds; i++) {
+		if (buffered_fds[i].captured != NULL) {
+			// Kept until end_capture_buffered
+			swap_buffered_fds(i, n_captured++);
+			continue;
+		}
+		if (write_all(buffered_fds[i].fd, buffered_fds[i].buffer->data,
+			      buffered_fds[i].buffer->len) < 0) {
+			ret = -1;
+		}
+		reset_buffer(buffered_fds[i].buffer);
+	}
+	n_buffered_fds = n_captured;
+	return ret;
+}
+
+void
+capture_buffered(int fd, Buffer * buffer)
+{
+	int i;
+
+	get_fd_buffer(fd);
+	for (i = 0; i < n_buffered_fds; i++) {
+		if (buffered_fds[i].fd == fd) {
+			buffered_fds[i].captured = buffer;
+		}
+	}
+}
+
+void
+end_capture_buffered()
+{
+	int i;
+
+	for (i = 0; i < n_buffered_fds; i++) {
+		if (buffered_fds[i].captured != NULL) {
+			buffered_fds[i].captured = NULL;
+			swap_buffered_fds(i--, --n_buffered_fds);
+		}
+	}
+}
+
+// Each slot keeps its own buffer, so they are moved together
+static void
+swap_buffered_fds(int i, int j)
+{
+	int fd = buffered_fds[i].fd;
+	Buffer *buffer = buffered_fds[i].buffer;
+	Buffer *captured = buffered_fds[i].captured;
+
+	buffered_fds[i].fd = buffered_fds[j].fd;
+	buffered_fds[i].buffer = buffered_fds[j].buffer;
+	buffered_fds[i].captured = buffered_fds[j].captured;
+	buffered_fds[j].fd = fd;
+	buffered_fds[j].buffer = buffer;
+	buffered_fds[j].captured = captured;
+}
+
+static Buffer *
+get_fd_buffer(int fd)
+{
+	int i;
+
+	for (i = 0; i < n_buffered_fds; i++) {
+		if (buffered_fds[i].fd == fd) {
+			if (buffered_fds[i].captured != NULL) {
+				return buffered_fds[i].captured;
+			}
+			return buffered_fds[i].buffer;
+		}
+	}
+
+	if (n_buffered_fds == MAX_BUFFERED_FDS) {
+		flush_buffered();
+	}
+	// Buffers are kept for the next builtin
+	if (buffered_fds[n_buffered_fds].buffer == NULL) {
+		buffered_fds[n_buffered_fds].buffer = new_buffer();
+	}
+	buffered_fds[n_buffered_fds].fd = fd;
+	return buffered_fds[n_buffered_fds++].buffer;
+}
+
+static int
+write_all(int fd, const char *data, size_t len)
+{
+	ssize_t bytes;
+
+	while (len > 0) {
+		bytes = write(fd, data, len);
+		if (bytes < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+		data += bytes;
+		len -= bytes;
+	}
+	return 0;
+}
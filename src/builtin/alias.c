@@ -17,23 +17,49 @@
 #include <err.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include "buffer.h"
+#include "builtin/command.h"
 #include "builtin/alias.h"
 
 // DECLARE STATIC FUNCTION
 static int usage();
+static unsigned int hash_alias(const char *name);
+static struct alias *find_alias_slot(struct alias *table, size_t size,
+				     const char *name, unsigned int hash);
+static void grow_aliases();
+static int compare_aliases(const void *a, const void *b);
+static int print_alias(const char *name);
+static void split_reference(struct alias *alias);
+static void free_alias(struct alias *alias);
 static int out_fd;
 static int err_fd;
 
 // DECLARE GLOBAL VARIABLE
-struct alias *aliases[ALIAS_MAX];
-char *alias_use = "alias [name=value]";
+char *alias_use = "alias [name[=value] ...]";
 char *alias_description = "Define or display aliases.";
 char *alias_help =
     "    Without arguments, `alias' prints the list of aliases in the reusable\n"
     "    form `alias NAME=VALUE' on standard output.\n\n"
-    "    Otherwise, an alias is defined for each NAME whose VALUE is given.\n\n"
+    "    Otherwise, an alias is defined for each NAME whose VALUE is given and\n"
+    "    the alias of each NAME without VALUE is printed.\n\n"
     "    Exit Status:\n"
-    "    alias returns 0 unless a VALUE is missing or the is out of memory.\n";
+    "    alias returns 0 unless a VALUE is missing or a NAME has no alias.\n";
+char *unalias_use = "unalias [-a] name [name ...]";
+char *unalias_description = "Remove each NAME from the list of defined aliases.";
+char *unalias_help =
+    "    Options:\n"
+    "      -a	remove all alias definitions\n\n"
+    "    Exit Status:\n"
+    "    Return success unless a NAME is not an existing alias.\n";
+
+// Characters the lexer gives a meaning to, = only matters in the first
+// word, where it makes an assignment
+static const char *special_chars = "|&;<>()$`\\\"'*?[]{}~#!\n";
+
+// Open addressing with linear probing, removed entries are backward shifted
+static struct alias *aliases;
+static size_t aliases_size;
+static size_t n_aliases;
 
 static int
 help()
@@ -56,97 +82,360 @@ alias(int argc, char *argv[], int stdout_fd, int stderr_fd)
 	argc--;
 	argv++;
 	int exit_value = EXIT_SUCCESS;
+	int i;
 
 	out_fd = stdout_fd;
 	err_fd = stderr_fd;
 	if (argc == 0) {
 		print_aliases();
-	} else if (argc == 1) {
-		if (strcmp(argv[0], "--help") == 0) {
-			return help();
-		}
-		exit_value = add_alias(argv[0]);
-		if (exit_value < 0) {
+		return EXIT_SUCCESS;
+	} else if (argc == 1 && strcmp(argv[0], "--help") == 0) {
+		return help();
+	}
+
+	for (i = 0; i < argc; i++) {
+		if (strchr(argv[i], '=') == NULL) {
+			if (print_alias(argv[i]) != EXIT_SUCCESS) {
+				exit_value = EXIT_FAILURE;
+			}
+		} else if (add_alias(argv[i]) < 0) {
 			return usage();
 		}
-	} else {
-		return usage();
 	}
 	return exit_value;
 }
 
-struct alias *
-new_alias(const char *command, char *reference)
+int
+unalias(int argc, char *argv[], int stdout_fd, int stderr_fd)
 {
-	struct alias *alias = (struct alias *)malloc(sizeof(struct alias));
+	argc--;
+	argv++;
+	int exit_value = EXIT_SUCCESS;
+	int i;
 
-	// Check if malloc failed
-	if (alias == NULL) {
-		err(EXIT_FAILURE, "malloc failed");
+	out_fd = stdout_fd;
+	err_fd = stderr_fd;
+	if (argc == 0) {
+		dprintf(err_fd, "Usage: %s\n", unalias_use);
+		return EXIT_FAILURE;
+	} else if (argc == 1 && strcmp(argv[0], "--help") == 0) {
+		dprintf(out_fd, "unalias: %s\n", unalias_use);
+		dprintf(out_fd, "    %s\n\n%s", unalias_description,
+			unalias_help);
+		return EXIT_SUCCESS;
+	} else if (strcmp(argv[0], "-a") == 0) {
+		free_aliases();
+		return EXIT_SUCCESS;
 	}
-	strcpy(alias->command, command);
-	strcpy(alias->reference, reference);
 
-	return alias;
+	for (i = 0; i < argc; i++) {
+		if (remove_alias(argv[i]) < 0) {
+			dprintf(err_fd, "mash: unalias: %s: not found\n",
+				argv[i]);
+			exit_value = EXIT_FAILURE;
+		}
+	}
+	return exit_value;
 }
 
 int
 add_alias(char *command)
 {
 	char *p, *eol;
-	int index;
 
 	p = strchr(command, '=');
-	if (p != NULL) {
-		*p = '\0';
-		// Remove '\n'
-		eol = strchr(++p, '\n');
-		if (eol != NULL) {
-			*eol = '\0';
-		}
+	if (p == NULL || p == command) {
+		return -1;
+	}
+	*p = '\0';
+	// Remove '\n'
+	eol = strchr(++p, '\n');
+	if (eol != NULL) {
+		*eol = '\0';
+	}
+
+	if (strlen(p) <= 0) {
+		return -1;
+	}
+	set_alias(command, p);
+	return 0;
+}
+
+void
+set_alias(const char *name, const char *value)
+{
+	char *reference;
+	unsigned int hash;
+	struct alias *alias;
 
-		if (strlen(p) <= 0) {
-			return -1;
+	reference = strdup(value);
+	if (reference == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+
+	if (aliases == NULL) {
+		aliases_size = ALIAS_INITIAL_SIZE;
+		aliases = calloc(aliases_size, sizeof(struct alias));
+		if (aliases == NULL) {
+			err(EXIT_FAILURE, "malloc failed");
 		}
+	}
+	hash = hash_alias(name);
+	alias = find_alias_slot(aliases, aliases_size, name, hash);
 
-		struct alias *alias = new_alias(command, p);
+	// A redefinition replaces the old reference in place
+	if (alias->command != NULL) {
+		free(alias->reference);
+		free(alias->words);
+		alias->reference = reference;
+		split_reference(alias);
+		return;
+	}
+	// Keep the load factor under 3/4
+	if ((n_aliases + 1) * 4 > aliases_size * 3) {
+		grow_aliases();
+		alias = find_alias_slot(aliases, aliases_size, name, hash);
+	}
+	alias->command = strdup(name);
+	if (alias->command == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	alias->reference = reference;
+	alias->hash = hash;
+	alias->is_expanding = 0;
+	split_reference(alias);
+	n_aliases++;
+}
 
-		for (index = 0; index < ALIAS_MAX; index++) {
-			if (aliases[index] == NULL) {
-				aliases[index] = alias;
-				return 0;
-			}
+int
+remove_alias(const char *name)
+{
+	struct alias *alias;
+	size_t hole, i, home;
+
+	if (aliases == NULL) {
+		return -1;
+	}
+	alias = find_alias_slot(aliases, aliases_size, name, hash_alias(name));
+	if (alias->command == NULL) {
+		return -1;
+	}
+	free_alias(alias);
+	n_aliases--;
+
+	// Move back the entries that probed past the removed one
+	hole = alias - aliases;
+	for (i = (hole + 1) & (aliases_size - 1); aliases[i].command != NULL;
+	     i = (i + 1) & (aliases_size - 1)) {
+		home = aliases[i].hash & (aliases_size - 1);
+		if (((i - home) & (aliases_size - 1)) >=
+		    ((i - hole) & (aliases_size - 1))) {
+			aliases[hole] = aliases[i];
+			aliases[i].command = NULL;
+			hole = i;
 		}
-		dprintf(err_fd, "Failed to add new alias. Already at limit.\n");
-		return 1;
 	}
-	return -1;
+	return 0;
 }
 
 char *
 get_alias(const char *name)
 {
-	int i;
+	struct alias *alias = find_alias(name);
 
-	for (i = 0; i < ALIAS_MAX; i++) {
-		if (aliases[i] == NULL)
-			break;
-		if (strcmp(aliases[i]->command, name) == 0) {
-			return aliases[i]->reference;
+	return alias == NULL ? NULL : alias->reference;
+}
+
+struct alias *
+find_alias(const char *name)
+{
+	struct alias *alias;
+
+	if (n_aliases == 0) {
+		return NULL;
+	}
+	alias = find_alias_slot(aliases, aliases_size, name, hash_alias(name));
+	return alias->command == NULL ? NULL : alias;
+}
+
+struct alias *
+next_alias(size_t *index)
+{
+	while (*index < aliases_size) {
+		if (aliases[(*index)++].command != NULL) {
+			return &aliases[*index - 1];
 		}
 	}
 	return NULL;
 }
 
+// Aliases are printed sorted by name
 void
 print_aliases()
 {
-	int i;
+	struct alias **sorted;
+	size_t i, n = 0;
 
-	for (i = 0; i < ALIAS_MAX; i++) {
-		if (aliases[i] == NULL)
+	if (n_aliases == 0) {
+		return;
+	}
+	sorted = malloc(n_aliases * sizeof(struct alias *));
+	if (sorted == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	for (i = 0; i < aliases_size; i++) {
+		if (aliases[i].command != NULL) {
+			sorted[n++] = &aliases[i];
+		}
+	}
+	qsort(sorted, n, sizeof(struct alias *), compare_aliases);
+	for (i = 0; i < n; i++) {
+		dprintf_buffered(out_fd, "alias %s=%s\n",
+				 sorted[i]->command, sorted[i]->reference);
+	}
+	free(sorted);
+}
+
+void
+free_aliases()
+{
+	size_t i;
+
+	for (i = 0; i < aliases_size; i++) {
+		if (aliases[i].command != NULL) {
+			free_alias(&aliases[i]);
+		}
+	}
+	free(aliases);
+	aliases = NULL;
+	aliases_size = 0;
+	n_aliases = 0;
+}
+
+static int
+print_alias(const char *name)
+{
+	char *reference = get_alias(name);
+
+	if (reference == NULL) {
+		dprintf(err_fd, "mash: alias: %s: not found\n", name);
+		return EXIT_FAILURE;
+	}
+	dprintf_buffered(out_fd, "alias %s=%s\n", name, reference);
+	return EXIT_SUCCESS;
+}
+
+// Only references made of plain words are split, the rest are parsed
+// again every time the alias is used
+static void
+split_reference(struct alias *alias)
+{
+	char *block;
+	char *word;
+	size_t len = strlen(alias->reference);
+	int n_words = 0;
+
+	alias->words = NULL;
+	alias->n_words = 0;
+	if (strpbrk(alias->reference, special_chars) != NULL) {
+		return;
+	}
+	word = alias->reference + strspn(alias->reference, " \t");
+	if (memchr(word, '=', strcspn(word, " \t")) != NULL) {
+		return;
+	}
+	for (word = alias->reference; *word != '\0'; n_words++) {
+		word += strspn(word, " \t");
+		if (*word == '\0') {
 			break;
-		dprintf(out_fd, "alias %s=%s\n", aliases[i]->command,
-			aliases[i]->reference);
+		}
+		if (strcspn(word, " \t") >= MAX_ARGUMENT_SIZE) {
+			return;
+		}
+		word += strcspn(word, " \t");
 	}
+	if (n_words == 0 || n_words >= MAX_ARGUMENTS) {
+		return;
+	}
+
+	// The pointers and the words are a single allocation
+	alias->words = malloc((n_words + 1) * sizeof(char *) + len + 1);
+	if (alias->words == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	block = (char *)(alias->words + n_words + 1);
+	strcpy(block, alias->reference);
+	for (word = strtok(block, " \t"); word != NULL;
+	     word = strtok(NULL, " \t")) {
+		alias->words[alias->n_words++] = word;
+	}
+	alias->words[alias->n_words] = NULL;
+}
+
+static void
+free_alias(struct alias *alias)
+{
+	free(alias->command);
+	free(alias->reference);
+	free(alias->words);
+	alias->command = NULL;
+}
+
+// FNV-1a
+static unsigned int
+hash_alias(const char *name)
+{
+	unsigned int hash = 2166136261u;
+
+	for (; *name != '\0'; name++) {
+		hash ^= (unsigned char)*name;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static struct alias *
+find_alias_slot(struct alias *table, size_t size, const char *name,
+		unsigned int hash)
+{
+	size_t i = hash & (size - 1);
+
+	while (table[i].command != NULL) {
+		if (table[i].hash == hash && strcmp(table[i].command, name) == 0) {
+			break;
+		}
+		i = (i + 1) & (size - 1);
+	}
+	return &table[i];
+}
+
+static void
+grow_aliases()
+{
+	size_t i;
+	size_t new_size = aliases_size * 2;
+	struct alias *new_aliases = calloc(new_size, sizeof(struct alias));
+	struct alias *slot;
+
+	if (new_aliases == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	for (i = 0; i < aliases_size; i++) {
+		if (aliases[i].command != NULL) {
+			slot = find_alias_slot(new_aliases, new_size,
+					       aliases[i].command,
+					       aliases[i].hash);
+			*slot = aliases[i];
+		}
+	}
+	free(aliases);
+	aliases = new_aliases;
+	aliases_size = new_size;
+}
+
+static int
+compare_aliases(const void *a, const void *b)
+{
+	return strcmp((*(struct alias **)a)->command,
+		      (*(struct alias **)b)->command);
 }
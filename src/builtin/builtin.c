@@ -22,11 +22,16 @@
 #include <stdio.h>
 #include <string.h>
 #include "open_files.h"
+#include "variables.h"
+#include "buffer.h"
 #include "builtin/command.h"
 #include "builtin/export.h"
 #include "builtin/source.h"
 #include "builtin/alias.h"
 #include "builtin/exit.h"
+#include "builtin/exec.h"
+#include "builtin/declare.h"
+#include "builtin/mapfile.h"
 #include "builtin/mash_pwd.h"
 #include "builtin/echo.h"
 #include "builtin/mash_math.h"
@@ -50,13 +55,16 @@
 
 char *builtins_modify_cmd[4] = { "ifnot", "ifok", "builtin", "command" };
 
-char *builtins_in_shell[10] =
+char *builtins_in_shell[15] =
     { "disown", "kill", "wait", "bg", "fg", "cd", "export", "alias", "exit",
-	"source"
+	"source", "exec", "declare", "mapfile", "readarray", "unalias"
 };
 char *builtins_fork[6] = { "math", "help", "sleep", "pwd", "echo", "jobs" };
 
-int N_BUILTINS = 4 + 10 + 6;
+// Fork builtins that only write output, safe to run inside $()
+char *builtins_in_buffer[3] = { "math", "pwd", "echo" };
+
+int N_BUILTINS = 4 + 15 + 6;
 
 // Builtin command
 char *builtin_use = "builtin shell-builtin [arg ..]";
@@ -148,11 +156,12 @@ found_builtin_exec_in_shell(Command * command)
 {
 	int i;
 
-	if (command->argc == 1 && strrchr(command->argv[0], '=')) {
+	if (command->array_assignment != NO_ARRAY_ASSIGNMENT
+	    || (command->argc == 1 && strrchr(command->argv[0], '='))) {
 		return 1;
 	}
 
-	for (i = 0; i < 10; i++) {
+	for (i = 0; i < 15; i++) {
 		if (strcmp(command->argv[0], builtins_in_shell[i]) == 0) {
 			return 1;
 		}
@@ -199,18 +208,44 @@ wait_for_heredoc()
 	return;
 }
 
+// name=(elements ...), every argument after name= is an element
+static int
+assign_array(Command * command, int err_fd)
+{
+	char *elements[MAX_ARGUMENTS];
+	int i;
+
+	if (command->array_assignment == ARRAY_ASSIGNMENT_OPEN) {
+		dprintf(err_fd,
+			"Mash: syntax error near unexpected token `newline'\n");
+		return EXIT_FAILURE;
+	}
+	for (i = 1; i < command->argc; i++) {
+		elements[i - 1] = command->argv[i];
+	}
+	*strchr(command->argv[0], '=') = '\0';
+	if (set_array(command->argv[0], elements, command->argc - 1) < 0) {
+		dprintf(err_fd, "mash: %s: not a valid identifier\n",
+			command->argv[0]);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
 int
 exec_builtin_in_shell(Command * command, int is_pipe)
 {
 	int i;
 	int exit_code = EXIT_FAILURE;
-	int cmd_out = command->output;
-	int cmd_err = command->err_output;
+	int cmd_in = STDIN_FILENO;
+	int cmd_out = STDOUT_FILENO;
+	int cmd_err = STDERR_FILENO;
 
-	if (command->argc == 1 && strrchr(command->argv[0], '=')) {
-		strcpy(command->argv[1], command->argv[0]);
-		strcpy(command->argv[0], "export");
-		command->argc = 2;
+	// In a pipe the child already redirected them
+	if (!is_pipe) {
+		cmd_in = get_fd_cmd(command, STDIN_FILENO);
+		cmd_out = get_fd_cmd(command, STDOUT_FILENO);
+		cmd_err = get_fd_cmd(command, STDERR_FILENO);
 	}
 
 	char *args[command->argc];
@@ -229,8 +264,26 @@ exec_builtin_in_shell(Command * command, int is_pipe)
 		wait_for_heredoc();
 	}
 
-	if (strcmp(command->argv[0], "alias") == 0) {
+	if (command->array_assignment != NO_ARRAY_ASSIGNMENT) {
+		exit_code = assign_array(command, cmd_err);
+	} else if (command->argc == 1 && strrchr(command->argv[0], '=')) {
+		// Plain assignment, not exported unless it already was
+		exit_code = EXIT_SUCCESS;
+		switch (assign_var(command->argv[0], 0)) {
+		case -1:
+			dprintf(cmd_err, "mash: %s: not a valid identifier\n",
+				command->argv[0]);
+			exit_code = EXIT_FAILURE;
+			break;
+		case -2:
+			// The math error is already printed
+			exit_code = EXIT_FAILURE;
+			break;
+		}
+	} else if (strcmp(command->argv[0], "alias") == 0) {
 		exit_code = alias(i, args, cmd_out, cmd_err);
+	} else if (strcmp(command->argv[0], "unalias") == 0) {
+		exit_code = unalias(i, args, cmd_out, cmd_err);
 	} else if (strcmp(command->argv[0], "export") == 0) {
 		exit_code = export(i, args, cmd_out, cmd_err);
 	} else if (strcmp(command->argv[0], "exit") == 0) {
@@ -242,6 +295,13 @@ exec_builtin_in_shell(Command * command, int is_pipe)
 		exit_code = exit_mash(i, args, cmd_out, cmd_err);
 	} else if (strcmp(command->argv[0], "source") == 0) {
 		exit_code = source(i, args, cmd_out, cmd_err);
+	} else if (strcmp(command->argv[0], "exec") == 0) {
+		exit_code = mash_exec(command, i, args, cmd_out, cmd_err);
+	} else if (strcmp(command->argv[0], "declare") == 0) {
+		exit_code = declare(i, args, cmd_out, cmd_err);
+	} else if (strcmp(command->argv[0], "mapfile") == 0
+		   || strcmp(command->argv[0], "readarray") == 0) {
+		exit_code = mapfile(i, args, cmd_in, cmd_out, cmd_err);
 	} else if (strcmp(command->argv[0], "cd") == 0) {
 		exit_code = cd(i, args, cmd_out, cmd_err);
 	} else if (strcmp(command->argv[0], "fg") == 0) {
@@ -255,14 +315,84 @@ exec_builtin_in_shell(Command * command, int is_pipe)
 	} else if (strcmp(args[0], "disown") == 0) {
 		exit_code = disown(i, args, cmd_out, cmd_err);
 	}
+	flush_buffered();
 
 	if (!is_pipe) {
-		if (cmd_out != STDOUT_FILENO) {
-			close_fd(cmd_out);
+		if (command->output != STDOUT_FILENO) {
+			close_fd(command->output);
 		}
-		if (cmd_err != STDERR_FILENO) {
-			close_fd(cmd_err);
+		if (command->err_output != STDERR_FILENO
+		    && command->err_output != command->output) {
+			close_fd(command->err_output);
 		}
+		close_redirections(command);
+	}
+
+	return exit_code;
+}
+
+int
+has_builtin_exec_in_buffer(Command * command)
+{
+	if (command->output_buffer == NULL || command->pipe_next != NULL
+	    || command->do_wait == DO_NOT_WAIT_TO_FINISH
+	    || command->search_location == SEARCH_CMD_ONLY_COMMAND
+	    || command->input != STDIN_FILENO
+	    || command->output != STDOUT_FILENO
+	    || command->n_redirections > 0) {
+		return 0;
+	}
+
+	return is_builtin_in_buffer(command->argv[0]);
+}
+
+int
+is_builtin_in_buffer(char *name)
+{
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		if (strcmp(name, builtins_in_buffer[i]) == 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int
+exec_builtin_in_buffer(Command * command)
+{
+	int i;
+	int exit_code = EXIT_FAILURE;
+	int cmd_out = CAPTURED_FD;
+	int cmd_err = command->err_output;
+	char *args[command->argc + 1];
+
+	// The buffered output goes straight to the substitution
+	capture_buffered(cmd_out, command->output_buffer);
+
+	for (i = 0; i < command->argc; i++) {
+		if (strlen(command->argv[i]) > 0) {
+			args[i] = command->argv[i];
+		} else {
+			args[i] = NULL;
+			break;
+		}
+	}
+	args[i] = NULL;
+
+	if (strcmp(args[0], "echo") == 0) {
+		exit_code = echo(i, args, cmd_out, cmd_err);
+	} else if (strcmp(args[0], "pwd") == 0) {
+		exit_code = pwd(i, args, cmd_out, cmd_err);
+	} else if (strcmp(args[0], "math") == 0) {
+		exit_code = math(i, args, cmd_out, cmd_err);
+	}
+	flush_buffered();
+	end_capture_buffered();
+
+	if (cmd_err != STDERR_FILENO) {
+		close_fd(cmd_err);
 	}
 
 	return exit_code;
@@ -303,23 +433,24 @@ exec_builtin(Command * start_scommand, Command * command)
 	}
 	args[i] = NULL;
 	if (strcmp(args[0], "echo") == 0) {
-		return_value = echo(i, args);
+		return_value = echo(i, args, STDOUT_FILENO, STDERR_FILENO);
 	} else if (strcmp(args[0], "jobs") == 0) {
 		return_value = jobs(i, args);
 	} else if (strcmp(args[0], "pwd") == 0) {
-		return_value = pwd(i, args);
+		return_value = pwd(i, args, STDOUT_FILENO, STDERR_FILENO);
 	} else if (strcmp(args[0], "sleep") == 0) {
 		return_value = mash_sleep(i, args);
 	} else if (strcmp(args[0], "help") == 0) {
 		return_value = help(i, args);
 	} else if (strcmp(args[0], "math") == 0) {
-		return_value = math(i, args);
+		return_value = math(i, args, STDOUT_FILENO, STDERR_FILENO);
 	} else if (strcmp(args[0], "exit") != 0) {
 		if (found_builtin_exec_in_shell(command)) {
 			exec_builtin_in_shell(command, 1);
 		}
 		modify_cmd_builtin(command);
 	}
+	flush_buffered();
 	free_command_with_buf(start_scommand);
 	exit_mash(0, NULL, STDOUT_FILENO, STDERR_FILENO);
 	exit(return_value);
@@ -15,9 +15,11 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <pwd.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include "variables.h"
 #include "builtin/cd.h"
 
 char *cd_use = "cd [directory]";
@@ -29,6 +31,10 @@ char *cd_help =
     "    Exit Status:\n"
     "    Returns 0 if the directory is changed, and non-zero otherwise.\n";
 
+// DECLARE STATIC FUNCTIONS
+static int change_dir(char *dir);
+static int logical_path(char *path, char *dir);
+
 static int out_fd;
 static int err_fd;
 
@@ -61,26 +67,83 @@ cd(int argc, char *argv[], int stdout_fd, int stderr_fd)
 		return usage();
 	}
 	if (argc == 0) {
-		home = getenv("HOME");
+		home = get_var("HOME");
 		if (home == NULL) {
 			home = getpwuid(getuid())->pw_dir;
 		}
-		if (chdir(home) < 0) {
-			dprintf(err_fd, "mash: cd: %s: No such directory\n",
-				home);
-			return EXIT_FAILURE;
-		}
-	} else {
-		if (strcmp(argv[0], "--help") == 0) {
-			return help();
-		}
+		return change_dir(home);
+	}
+	if (strcmp(argv[0], "--help") == 0) {
+		return help();
+	}
+	return change_dir(argv[0]);
+}
 
-		if (chdir(argv[0]) < 0) {
-			dprintf(err_fd, "mash: cd: %s: No such directory\n",
-				argv[0]);
-			return EXIT_FAILURE;
+// PWD is only updated here, commands never look it up with getcwd
+static int
+change_dir(char *dir)
+{
+	char path[PATH_MAX];
+
+	if (logical_path(path, dir) && chdir(path) == 0) {
+		set_var("PWD", path, 0);
+		return EXIT_SUCCESS;
+	}
+	// The logical path may not exist, e.g. if PWD was removed
+	if (chdir(dir) < 0) {
+		dprintf(err_fd, "mash: cd: %s: No such directory\n", dir);
+		return EXIT_FAILURE;
+	}
+	if (getcwd(path, PATH_MAX) != NULL) {
+		set_var("PWD", path, 0);
+	}
+	return EXIT_SUCCESS;
+}
+
+// Resolves dir from PWD without following symlinks: a/.. is PWD
+static int
+logical_path(char *path, char *dir)
+{
+	char *pwd = get_var("PWD");
+	char dir_copy[PATH_MAX];
+	char *component;
+	char *saveptr;
+	char *last_slash;
+	size_t len = 0;
+
+	if (*dir != '/') {
+		if (pwd == NULL || *pwd != '/' || strlen(pwd) >= PATH_MAX) {
+			return 0;
 		}
+		strcpy(path, pwd);
+		len = strlen(path);
+	}
+	if (strlen(dir) >= PATH_MAX) {
+		return 0;
 	}
+	strcpy(dir_copy, dir);
 
-	return EXIT_SUCCESS;
+	for (component = strtok_r(dir_copy, "/", &saveptr); component != NULL;
+	     component = strtok_r(NULL, "/", &saveptr)) {
+		if (strcmp(component, ".") == 0) {
+			continue;
+		}
+		if (strcmp(component, "..") == 0) {
+			path[len] = '\0';
+			last_slash = strrchr(path, '/');
+			len = last_slash == NULL ? 0 : last_slash - path;
+			continue;
+		}
+		if (len + strlen(component) + 2 > PATH_MAX) {
+			return 0;
+		}
+		path[len++] = '/';
+		strcpy(path + len, component);
+		len += strlen(component);
+	}
+	if (len == 0) {
+		path[len++] = '/';
+	}
+	path[len] = '\0';
+	return 1;
 }
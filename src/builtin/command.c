@@ -15,15 +15,28 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <err.h>
 #include <errno.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include "open_files.h"
+#include "buffer.h"
 #include "builtin/alias.h"
 #include "builtin/command.h"
+#include "builtin/exec.h"
+
+// DECLARE STATIC FUNCTIONS
+static int redirect_fd(Command * command, int fd, int new_fd);
+static int add_output(Command * command, int fd, int new_fd);
+static int duplicate_fd(Command * command, int fd, int from);
+static void reset_fd(Command * command, int fd);
+static Redirection *find_redirection(Command * command, int fd);
+static int add_redirection(Command * command, int fd, int type, int source);
+static void remove_redirection(Command * command, int fd);
 
 // Builtin command
 
@@ -82,23 +95,35 @@ command(Command * command)
 }
 
 // ---------------
-Command *
-new_command()
+// Freed commands are kept to skip the malloc and the zeroing of argv
+static Command *command_pool[COMMAND_POOL_SIZE];
+static int n_pooled_commands = 0;
+
+// Only the argv that were used are zeroed, the rest are still empty
+static void
+clear_command(Command * command)
 {
-	Command *command = (Command *) malloc(sizeof(Command));
+	int i;
+	int used = command->max_argc;
 
-	// Check if malloc failed
-	if (command == NULL) {
-		err(EXIT_FAILURE, "malloc failed");
+	if (used > MAX_ARGUMENTS - 1) {
+		used = MAX_ARGUMENTS - 1;
+	}
+	for (i = 0; i <= used; i++) {
+		memset(command->argv[i], 0, MAX_ARGUMENT_SIZE);
 	}
-	memset(command, 0, sizeof(Command));
+	memset(&command->argc, 0,
+	       sizeof(Command) - offsetof(Command, argc));
 
 	command->argc = 0;
+	command->max_argc = 0;
 	command->current_arg = command->argv[0];
 	command->pid = 0;
 	command->search_location = SEARCH_CMD_EVERYWHERE;
+	command->array_assignment = NO_ARRAY_ASSIGNMENT;
 	command->next_status_needed_to_exec = DO_NOT_MATTER_TO_EXEC;
 	command->do_wait = WAIT_TO_FINISH;
+	command->envp = NULL;
 	command->input = STDIN_FILENO;
 	command->output = STDOUT_FILENO;
 	command->err_output = STDERR_FILENO;
@@ -107,8 +132,31 @@ new_command()
 	command->fd_pipe_output[0] = -1;
 	command->fd_pipe_output[1] = -1;
 	command->pipe_next = NULL;
+	command->n_extra_outputs = 0;
+	command->multio = NULL;
+	command->n_redirections = 0;
 	command->output_buffer = NULL;
+}
+
+Command *
+new_command()
+{
+	Command *command;
 
+	if (n_pooled_commands > 0) {
+		command = command_pool[--n_pooled_commands];
+		clear_command(command);
+		return command;
+	}
+
+	command = (Command *) malloc(sizeof(Command));
+	// Check if malloc failed
+	if (command == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	memset(command->argv, 0, sizeof(command->argv));
+	command->max_argc = 0;
+	clear_command(command);
 	return command;
 }
 
@@ -116,24 +164,19 @@ void
 reset_command(Command * command)
 {
 	free_command(command->pipe_next);
-	memset(command, 0, sizeof(*command));
-	command->argc = 0;
-	command->current_arg = command->argv[0];
-	command->pid = 0;
-	command->search_location = SEARCH_CMD_EVERYWHERE;
-	command->next_status_needed_to_exec = DO_NOT_MATTER_TO_EXEC;
-	command->do_wait = WAIT_TO_FINISH;
-	command->input = STDIN_FILENO;
-	command->output = STDOUT_FILENO;
-	command->err_output = STDERR_FILENO;
-	command->fd_pipe_input[0] = -1;
-	command->fd_pipe_input[1] = -1;
-	command->fd_pipe_output[0] = -1;
-	command->fd_pipe_output[1] = -1;
-	command->pipe_next = NULL;
-	command->output_buffer = NULL;
+	clear_command(command);
 };
 
+static void
+release_command(Command * command)
+{
+	if (n_pooled_commands < COMMAND_POOL_SIZE) {
+		command_pool[n_pooled_commands++] = command;
+	} else {
+		free(command);
+	}
+}
+
 void
 free_command(Command * command)
 {
@@ -143,7 +186,7 @@ free_command(Command * command)
 	while (next != NULL) {
 		to_free = next;
 		next = to_free->pipe_next;
-		free(to_free);
+		release_command(to_free);
 	}
 }
 
@@ -156,27 +199,22 @@ free_command_with_buf(Command * command)
 	while (next != NULL) {
 		to_free = next;
 		next = to_free->pipe_next;
-		free(to_free->output_buffer);
-		free(to_free);
-	}
-}
-
-extern int
-check_alias_cmd(Command * command)
-{
-	if (command->argc == 0) {
-		if (get_alias(command->argv[0]) != NULL) {
-			return 1;
+		// Only the last command of the pipe holds the output buffer
+		if (next == NULL) {
+			free_buffer(to_free->output_buffer);
 		}
+		release_command(to_free);
 	}
-	return 0;
-};
+}
 
 int
 add_arg(Command * command)
 {
 	if (++command->argc > MAX_ARGUMENTS)
 		return 0;
+	if (command->argc > command->max_argc) {
+		command->max_argc = command->argc;
+	}
 	command->current_arg = command->argv[command->argc];
 	return 1;
 }
@@ -194,53 +232,274 @@ set_file_cmd(Command * command, int file_type, char *file)
 {
 	switch (file_type) {
 	case HERE_DOC_READ:
-		if (command->input != STDIN_FILENO) {
-			close(command->input);
-		}
+		reset_fd(command, STDIN_FILENO);
 		command->input = HERE_DOC_FILENO;
 		return 1;
 		break;
+	case HERE_STRING_READ:
 	case INPUT_READ:
-		if (command->input != STDIN_FILENO) {
-			close(command->input);
-		}
-		command->input = open_read_file(file);
-		return command->input;
+	case READ_WRITE:
+		return set_fd_cmd(command, STDIN_FILENO, file_type, file);
+		break;
+	}
+	// GO TO LAST CMD IN PIPE
+	return set_fd_cmd(get_last_command(command), STDOUT_FILENO, file_type,
+			  file);
+}
+
+int
+set_fd_cmd(Command * command, int fd, int file_type, char *word)
+{
+	int new_fd;
+
+	switch (file_type) {
+	case HERE_STRING_READ:
+		return redirect_fd(command, fd, open_here_string(word));
+		break;
+	case INPUT_READ:
+		return redirect_fd(command, fd, open_read_file(word));
+		break;
+	case READ_WRITE:
+		return redirect_fd(command, fd, open_read_write_file(word));
 		break;
 	case OUTPUT_WRITE:
-		// GO TO LAST CMD IN PIPE
-		Command * last_cmd = get_last_command(command);
-		if (last_cmd->output != STDOUT_FILENO) {
-			close(last_cmd->output);
-		}
-		last_cmd->output = open_write_file(file);
-		return last_cmd->output;
+		return add_output(command, fd, open_write_file(word));
 		break;
-	case ERROR_WRITE:
-		// GO TO LAST CMD IN PIPE
-		Command * last_err_cmd = get_last_command(command);
-		if (last_err_cmd->err_output != STDERR_FILENO) {
-			close(last_err_cmd->err_output);
-		}
-		last_err_cmd->err_output = open_write_file(file);
-		return last_err_cmd->err_output;
+	case APPEND_WRITE:
+		return add_output(command, fd, open_append_file(word));
 		break;
 	case ERROR_AND_OUTPUT_WRITE:
-		// GO TO LAST CMD IN PIPE
-		Command * last_err_out_cmd = get_last_command(command);
-		if (last_err_out_cmd->output != STDOUT_FILENO) {
-			close(last_err_out_cmd->output);
+	case ERROR_AND_OUTPUT_APPEND:
+		if (file_type == ERROR_AND_OUTPUT_WRITE) {
+			new_fd = open_write_file(word);
+		} else {
+			new_fd = open_append_file(word);
+		}
+		if (redirect_fd(command, STDOUT_FILENO, new_fd) < 0) {
+			return -1;
+		}
+		reset_fd(command, STDERR_FILENO);
+		command->err_output = new_fd;
+		return new_fd;
+		break;
+	case DUPLICATE_FD:
+		if (strcmp(word, "-") == 0) {
+			reset_fd(command, fd);
+			return add_redirection(command, fd, REDIRECT_CLOSE, -1);
+		}
+		if (strlen(word) == 0 || strspn(word, "0123456789") != strlen(word)) {
+			fprintf(stderr, "Mash: %s: ambiguous redirect\n", word);
+			return -1;
 		}
-		last_err_out_cmd->output = open_write_file(file);
-		last_err_out_cmd->err_output = last_err_out_cmd->output;
-		return last_err_out_cmd->err_output;
+		return duplicate_fd(command, fd, atoi(word));
 		break;
 	}
 	return -1;
 }
 
 int
-set_buffer_cmd(Command * command, char *buffer)
+get_fd_cmd(Command * command, int fd)
+{
+	Redirection *redirection = find_redirection(command, fd);
+
+	if (redirection != NULL) {
+		// Duplicates use the std fd of the shell
+		return redirection->source;
+	}
+	switch (fd) {
+	case STDIN_FILENO:
+		return command->input > 0 ? command->input : STDIN_FILENO;
+	case STDOUT_FILENO:
+		return command->output;
+	case STDERR_FILENO:
+		return command->err_output;
+	}
+	return fd;
+}
+
+// Replaces whatever fd was redirected to with new_fd
+int
+redirect_fd(Command * command, int fd, int new_fd)
+{
+	if (new_fd < 0) {
+		return -1;
+	}
+	reset_fd(command, fd);
+	switch (fd) {
+	case STDIN_FILENO:
+		command->input = new_fd;
+		break;
+	case STDOUT_FILENO:
+		command->output = new_fd;
+		break;
+	case STDERR_FILENO:
+		command->err_output = new_fd;
+		break;
+	default:
+		if (add_redirection(command, fd, REDIRECT_FILE, new_fd) < 0) {
+			close(new_fd);
+			return -1;
+		}
+		break;
+	}
+	return new_fd;
+}
+
+int
+add_output(Command * command, int fd, int new_fd)
+{
+	if (new_fd < 0) {
+		return -1;
+	}
+	if (fd != STDOUT_FILENO || command->output == STDOUT_FILENO) {
+		return redirect_fd(command, fd, new_fd);
+	}
+	// Write to every file, like zsh multios
+	if (command->n_extra_outputs >= MAX_EXTRA_OUTPUTS) {
+		fprintf(stderr, "Mash: too many outputs\n");
+		close(new_fd);
+		return -1;
+	}
+	command->extra_output[command->n_extra_outputs++] = new_fd;
+	return new_fd;
+}
+
+int
+duplicate_fd(Command * command, int fd, int from)
+{
+	Redirection *redirection = find_redirection(command, from);
+	int source = -1;
+	int new_fd;
+
+	if (fd == from) {
+		return fd;
+	}
+	if (redirection != NULL) {
+		switch (redirection->type) {
+		case REDIRECT_CLOSE:
+			reset_fd(command, fd);
+			return add_redirection(command, fd, REDIRECT_CLOSE, -1);
+			break;
+		case REDIRECT_DUP:
+			from = redirection->source;
+			break;
+		case REDIRECT_FILE:
+			source = redirection->source;
+			break;
+		}
+	} else if (from == STDIN_FILENO && command->input > 0) {
+		source = command->input;
+	} else if (from == STDOUT_FILENO && command->output != STDOUT_FILENO) {
+		source = command->output;
+	} else if (from == STDERR_FILENO
+		   && command->err_output != STDERR_FILENO) {
+		source = command->err_output;
+	} else if (from > STDERR_FILENO && !is_shell_fd(from)) {
+		// Open in the shell
+		source = from;
+	}
+
+	if (source < 0) {
+		// The std fd is only known in the child, it could be a pipe, and
+		// fds opened with exec are inherited without a dup in the shell
+		reset_fd(command, fd);
+		if (fd == from) {
+			return fd;
+		}
+		return add_redirection(command, fd, REDIRECT_DUP, from);
+	}
+	new_fd = fcntl(source, F_DUPFD_CLOEXEC, 0);
+	if (new_fd < 0) {
+		fprintf(stderr, "Mash: %d: Bad file descriptor\n", from);
+		return -1;
+	}
+	return redirect_fd(command, fd, new_fd);
+}
+
+void
+reset_fd(Command * command, int fd)
+{
+	int i;
+
+	remove_redirection(command, fd);
+	switch (fd) {
+	case STDIN_FILENO:
+		if (command->input > 0) {
+			close(command->input);
+		}
+		command->input = STDIN_FILENO;
+		break;
+	case STDOUT_FILENO:
+		if (command->output != STDOUT_FILENO
+		    && command->output != command->err_output) {
+			close(command->output);
+		}
+		for (i = 0; i < command->n_extra_outputs; i++) {
+			close(command->extra_output[i]);
+		}
+		command->n_extra_outputs = 0;
+		command->output = STDOUT_FILENO;
+		break;
+	case STDERR_FILENO:
+		if (command->err_output != STDERR_FILENO
+		    && command->err_output != command->output) {
+			close(command->err_output);
+		}
+		command->err_output = STDERR_FILENO;
+		break;
+	}
+}
+
+Redirection *
+find_redirection(Command * command, int fd)
+{
+	int i;
+
+	for (i = 0; i < command->n_redirections; i++) {
+		if (command->redirections[i].fd == fd) {
+			return &command->redirections[i];
+		}
+	}
+	return NULL;
+}
+
+int
+add_redirection(Command * command, int fd, int type, int source)
+{
+	Redirection *redirection;
+
+	if (command->n_redirections >= MAX_REDIRECTIONS) {
+		fprintf(stderr, "Mash: too many redirections\n");
+		return -1;
+	}
+	redirection = &command->redirections[command->n_redirections++];
+	redirection->fd = fd;
+	redirection->type = type;
+	redirection->source = source;
+	return fd;
+}
+
+void
+remove_redirection(Command * command, int fd)
+{
+	Redirection *redirection = find_redirection(command, fd);
+	Redirection *last;
+
+	if (redirection == NULL) {
+		return;
+	}
+	if (redirection->type == REDIRECT_FILE) {
+		close(redirection->source);
+	}
+	// Keep the order of the rest
+	last = &command->redirections[command->n_redirections - 1];
+	memmove(redirection, redirection + 1,
+		(last - redirection) * sizeof(Redirection));
+	command->n_redirections--;
+}
+
+int
+set_buffer_cmd(Command * command, Buffer * buffer)
 {
 	get_last_command(command)->output_buffer = buffer;
 	return 1;
@@ -0,0 +1,137 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "variables.h"
+#include "builtin/declare.h"
+
+// DECLARE GLOBAL VARIABLE
+char *declare_use = "declare [-aix] name[=value] ...";
+char *declare_description = "Set variable values and attributes.";
+char *declare_help =
+    "    Declares each NAME with the given attributes.  If VALUE is supplied,\n"
+    "    assign VALUE after setting the attributes.\n\n"
+    "    Options:\n"
+    "      -a	NAME is an indexed array, VALUE is its element 0\n"
+    "      -i	NAME is an integer, every value assigned to it is evaluated\n"
+    "    		as an arithmetic expression like in math\n"
+    "      -x	NAME is exported\n\n"
+    "    Exit Status:\n"
+    "    Returns success unless an invalid option is given, NAME is invalid or\n"
+    "    the arithmetic expression of an integer fails.\n";
+
+static int out_fd;
+static int err_fd;
+
+// DECLARE STATIC FUNCTIONS
+static int help();
+static int usage();
+static int parse_flags(const char *option, int *flags);
+static int declare_var(char *declaration, int flags);
+
+static int
+help()
+{
+	dprintf(out_fd, "declare: %s\n", declare_use);
+	dprintf(out_fd, "    %s\n\n%s", declare_description, declare_help);
+	return EXIT_SUCCESS;
+}
+
+static int
+usage()
+{
+	dprintf(err_fd, "Usage: %s\n", declare_use);
+	return EXIT_FAILURE;
+}
+
+static int
+parse_flags(const char *option, int *flags)
+{
+	for (option++; *option != '\0'; option++) {
+		switch (*option) {
+		case 'a':
+			*flags |= VAR_ARRAY;
+			break;
+		case 'i':
+			*flags |= VAR_INTEGER;
+			break;
+		case 'x':
+			*flags |= VAR_EXPORTED;
+			break;
+		default:
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int
+declare_var(char *declaration, int flags)
+{
+	char *value = strchr(declaration, '=');
+	int result;
+
+	if (value != NULL) {
+		*value++ = '\0';
+		result = set_var(declaration, value, flags);
+	} else if (get_var(declaration) != NULL) {
+		result = set_var_flags(declaration, flags);
+	} else if (flags & VAR_ARRAY) {
+		result = set_array(declaration, NULL, 0);
+	} else {
+		// An empty integer is 0
+		result = set_var(declaration, "", flags);
+	}
+
+	if (result == -1) {
+		dprintf(err_fd, "mash: declare: `%s': not a valid identifier\n",
+			declaration);
+	}
+	return result < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int
+declare(int argc, char *argv[], int stdout_fd, int stderr_fd)
+{
+	argc--;
+	argv++;
+	int flags = 0;
+	int exit_value = EXIT_SUCCESS;
+	int i;
+
+	out_fd = stdout_fd;
+	err_fd = stderr_fd;
+
+	if (argc == 1 && strcmp(argv[0], "--help") == 0) {
+		return help();
+	}
+
+	for (i = 0; i < argc && argv[i][0] == '-'; i++) {
+		if (parse_flags(argv[i], &flags) < 0) {
+			return usage();
+		}
+	}
+	if (i == argc || (flags & VAR_ARRAY && flags & VAR_INTEGER)) {
+		return usage();
+	}
+
+	for (; i < argc; i++) {
+		if (declare_var(argv[i], flags) != EXIT_SUCCESS) {
+			exit_value = EXIT_FAILURE;
+		}
+	}
+	return exit_value;
+}
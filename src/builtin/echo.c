@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include "buffer.h"
 #include "builtin/echo.h"
 
 char *echo_use = "echo [-n] [arg ...]";
@@ -26,12 +27,18 @@ char *echo_help =
     "      -n    do not append a newline\n"
     "    Exit Status:\n" "    Returns success unless a write error occurs.\n";
 
+static int out_fd;
+static int err_fd;
+
 int
-echo(int argc, char *argv[])
+echo(int argc, char *argv[], int stdout_fd, int stderr_fd)
 {
 	int i;
 	int print_newline = 1;
 
+	out_fd = stdout_fd;
+	err_fd = stderr_fd;
+
 	argc--;
 	argv++;
 
@@ -43,15 +50,15 @@ echo(int argc, char *argv[])
 		}
 	}
 
-	if (argc) {
-		for (i = 0; i < argc - 1; i++) {
-			printf("%s ", argv[i]);
+	for (i = 0; i < argc; i++) {
+		if (i > 0) {
+			write_buffered(out_fd, " ", 1);
 		}
-		printf("%s", argv[i]);
+		write_buffered(out_fd, argv[i], strlen(argv[i]));
 	}
 
 	if (print_newline) {
-		printf("\n");
+		write_buffered(out_fd, "\n", 1);
 	}
 	return EXIT_SUCCESS;
 }
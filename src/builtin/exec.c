@@ -0,0 +1,141 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "open_files.h"
+#include "variables.h"
+#include "builtin/command.h"
+#include "exec_cmd.h"
+#include "builtin/exec.h"
+
+extern char **environ;
+
+char *exec_use = "exec [command [argument ...]] [redirection ...]";
+char *exec_description = "Replace the shell with the given command.";
+char *exec_help =
+    "    Execute COMMAND, replacing this shell with the specified program.\n"
+    "    ARGUMENTS become the arguments to COMMAND.  If COMMAND is not\n"
+    "    specified, any redirections take effect in the current shell, so\n"
+    "    every later command inherits them:\n\n"
+    "      exec 3>>run.log\n"
+    "      echo started >&3\n"
+    "      exec 3>&-\n\n"
+    "    Only fds below 10 can be redirected this way.\n\n"
+    "    Exit Status:\n"
+    "    Returns success unless COMMAND is not found or a redirection error\n"
+    "    occurs.\n";
+
+// Fds of the shell opened with exec
+static char shell_fds[MAX_SHELL_FDS];
+
+static int out_fd;
+static int err_fd;
+
+static int
+help()
+{
+	dprintf(out_fd, "exec: %s\n", exec_use);
+	dprintf(out_fd, "    %s\n\n%s", exec_description, exec_help);
+	return EXIT_SUCCESS;
+}
+
+static int
+check_redirections(Command * command)
+{
+	int i;
+
+	if (command->n_extra_outputs > 0
+	    || command->input == HERE_DOC_FILENO) {
+		dprintf(err_fd, "mash: exec: unsupported redirection\n");
+		return 0;
+	}
+	for (i = 0; i < command->n_redirections; i++) {
+		if (command->redirections[i].fd >= MAX_SHELL_FDS) {
+			dprintf(err_fd, "mash: exec: %d: fd out of range\n",
+				command->redirections[i].fd);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int
+mash_exec(Command * command, int argc, char *argv[], int stdout_fd,
+	  int stderr_fd)
+{
+	int i;
+	int fd;
+	int exec_errno;
+	char **shell_environ;
+
+	out_fd = stdout_fd;
+	err_fd = stderr_fd;
+
+	if (argc == 2 && strcmp(argv[1], "--help") == 0) {
+		return help();
+	}
+
+	if (!check_redirections(command)) {
+		return EXIT_FAILURE;
+	}
+
+	// Nothing buffered can end up in the new files
+	fflush(stdout);
+	fflush(stderr);
+
+	// The old files behind these fds are closed by the redirections
+	for (i = 0; i < command->n_redirections; i++) {
+		shell_fds[command->redirections[i].fd] = 0;
+	}
+	redirect_fds(command);
+	for (i = 0; i < command->n_redirections; i++) {
+		fd = command->redirections[i].fd;
+		if (fd > STDERR_FILENO
+		    && command->redirections[i].type != REDIRECT_CLOSE) {
+			shell_fds[fd] = 1;
+		}
+	}
+
+	// They are now the fds of the shell, not files of this command
+	command->input = STDIN_FILENO;
+	command->output = STDOUT_FILENO;
+	command->err_output = STDERR_FILENO;
+	command->n_redirections = 0;
+
+	if (argc > 1) {
+		// execvp searches the PATH of environ, restored if it fails
+		shell_environ = environ;
+		environ = get_envp();
+		execvp(argv[1], &argv[1]);
+		exec_errno = errno;
+		environ = shell_environ;
+		dprintf(STDERR_FILENO, "mash: exec: %s: %s\n", argv[1],
+			strerror(exec_errno));
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+int
+is_shell_fd(int fd)
+{
+	if (fd <= STDERR_FILENO || fd >= MAX_SHELL_FDS) {
+		return 0;
+	}
+	return shell_fds[fd];
+}
@@ -25,6 +25,7 @@
 #include "exec_info.h"
 #include "parse_line.h"
 #include "builtin/jobs.h"
+#include "mash.h"
 #include "builtin/exit.h"
 
 // DECLARE GLOBAL VARIABLE
@@ -58,16 +59,7 @@ exit_mash(int argc, char *argv[], int stdout_fd, int stderr_fd)
 {
 	argc--;
 	argv++;
-	int i;
-	char *result = get_env_by_name("result");
-	int exit_status;
-
-	if (result == NULL) {
-		dprintf(err_fd, "error: var result does not exist\n");
-	}
-
-	exit_status = atoi(result);
-	free(result);
+	int exit_status = last_status;
 
 	out_fd = stdout_fd;
 	err_fd = stderr_fd;
@@ -84,13 +76,9 @@ exit_mash(int argc, char *argv[], int stdout_fd, int stderr_fd)
 		return usage();
 	}
 
-	for (i = 0; i < ALIAS_MAX; i++) {
-		if (aliases[i] == NULL)
-			break;
-		free(aliases[i]);
-	}
+	free_aliases();
 
-	free_source_file();
+	free_sources();
 
 	free_jobs_list();
 
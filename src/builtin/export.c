@@ -12,24 +12,44 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <ctype.h>
 #include <err.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include "buffer.h"
+#include "variables.h"
 #include "builtin/export.h"
 
-extern char **environ;
-char *export_use = "export [name=value]";
+char *export_use = "export [-s] [-f file] [name[=value] ...]";
 char *export_description = "Set export attribute for shell variables.";
 char *export_help =
     "    Marks each NAME for automatic export to the environment of subsequently\n"
     "    executed commands.  If VALUE is supplied, assign VALUE before exporting.\n\n"
+    "    Options:\n"
+    "      -f	export every NAME=VALUE line of a dotenv FILE\n"
+    "      -s	show how many times the environment of commands was built\n"
+    "    		and how many times it was reused\n\n"
+    "    Lines of FILE can start with export, values can be quoted with ' or \"\n"
+    "    and lines starting with # are ignored.\n\n"
     "    Exit Status:\n"
     "    Returns success unless an invalid option is given or NAME is invalid.\n";
 
 static int out_fd;
 static int err_fd;
 
+// DECLARE STATIC FUNCTIONS
+static int export_file(const char *path);
+static const char *export_line(const char *line, const char *end,
+			       Buffer * name, Buffer * value, int *status);
+static const char *read_value(const char *ptr, const char *end,
+			      Buffer * value);
+
 static int
 help()
 {
@@ -50,24 +70,192 @@ export(int argc, char *argv[], int stdout_fd, int stderr_fd)
 {
 	argc--;
 	argv++;
-	int exit_value = 0;
+	int exit_value = EXIT_SUCCESS;
+	int i;
 
 	out_fd = stdout_fd;
 	err_fd = stderr_fd;
 
 	if (argc == 0) {
 		print_env();
-	} else if (argc == 1) {
-		if (strcmp(argv[0], "--help") == 0) {
-			return help();
+		return EXIT_SUCCESS;
+	} else if (argc == 1 && strcmp(argv[0], "--help") == 0) {
+		return help();
+	} else if (argc == 1 && strcmp(argv[0], "-s") == 0) {
+		dprintf_buffered(out_fd, "envp rebuilt %lu, reused %lu\n",
+				 envp_rebuilds, envp_reuses);
+		return EXIT_SUCCESS;
+	}
+
+	for (i = 0; i < argc; i++) {
+		if (strcmp(argv[i], "-f") == 0) {
+			if (++i == argc) {
+				return usage();
+			}
+			if (export_file(argv[i]) != EXIT_SUCCESS) {
+				exit_value = EXIT_FAILURE;
+			}
+		} else if (argv[i][0] == '-') {
+			return usage();
+		} else if (add_env(argv[i]) != EXIT_SUCCESS) {
+			exit_value = EXIT_FAILURE;
 		}
-		exit_value = add_env(argv[0]);
-	} else {
-		return usage();
 	}
 	return exit_value;
 }
 
+// The whole file is mapped and parsed in a single pass
+static int
+export_file(const char *path)
+{
+	struct stat st;
+	const char *data;
+	const char *ptr;
+	const char *next;
+	Buffer *name;
+	Buffer *value;
+	size_t lineno = 1;
+	int status = EXIT_SUCCESS;
+	int line_status;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		dprintf(err_fd, "mash: export: %s: %m\n", path);
+		if (fd >= 0) {
+			close(fd);
+		}
+		return EXIT_FAILURE;
+	}
+	if (st.st_size == 0) {
+		close(fd);
+		return EXIT_SUCCESS;
+	}
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		dprintf(err_fd, "mash: export: %s: %m\n", path);
+		return EXIT_FAILURE;
+	}
+
+	name = new_buffer();
+	value = new_buffer();
+	for (ptr = data; ptr < data + st.st_size; ptr = next) {
+		line_status = EXIT_SUCCESS;
+		next = export_line(ptr, data + st.st_size, name, value,
+				   &line_status);
+		if (line_status != EXIT_SUCCESS) {
+			dprintf(err_fd, "mash: export: %s:%zu: invalid line "
+				"ignored\n", path, lineno);
+			status = EXIT_FAILURE;
+		}
+		// A quoted value can take several lines
+		while ((ptr = memchr(ptr, '\n', next - ptr)) != NULL) {
+			ptr++;
+			lineno++;
+		}
+	}
+	free_buffer(name);
+	free_buffer(value);
+	munmap((void *)data, st.st_size);
+	return status;
+}
+
+// Returns the start of the next line
+static const char *
+export_line(const char *line, const char *end, Buffer * name,
+	    Buffer * value, int *status)
+{
+	const char *ptr = line;
+	const char *eol = memchr(line, '\n', end - line);
+	const char *next = eol == NULL ? end : eol + 1;
+
+	if (eol == NULL) {
+		eol = end;
+	}
+	while (ptr < eol && isspace(*ptr)) {
+		ptr++;
+	}
+	if (ptr == eol || *ptr == '#') {
+		return next;
+	}
+	if (eol - ptr > 7 && strncmp(ptr, "export", 6) == 0
+	    && isblank(ptr[6])) {
+		for (ptr += 6; ptr < eol && isblank(*ptr); ptr++) ;
+	}
+
+	reset_buffer(name);
+	reset_buffer(value);
+	for (line = ptr; ptr < eol && *ptr != '=' && !isblank(*ptr); ptr++) ;
+	if (append_buffer(name, line, ptr - line) < 0) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	while (ptr < eol && isblank(*ptr)) {
+		ptr++;
+	}
+	if (ptr == eol || *ptr != '=') {
+		*status = EXIT_FAILURE;
+		return next;
+	}
+	ptr++;
+	while (ptr < eol && isblank(*ptr)) {
+		ptr++;
+	}
+
+	// A quoted value can have several lines
+	eol = read_value(ptr, end, value);
+	if (eol == NULL || set_var(name->data, value->data, VAR_EXPORTED) < 0) {
+		*status = EXIT_FAILURE;
+		return next;
+	}
+	return eol;
+}
+
+// Returns the start of the next line or NULL if a quote is not closed
+static const char *
+read_value(const char *ptr, const char *end, Buffer * value)
+{
+	const char *start;
+	char quote = '\0';
+	char c;
+
+	if (ptr < end && (*ptr == '"' || *ptr == '\'')) {
+		quote = *ptr++;
+	}
+	for (start = ptr; ptr < end; ptr++) {
+		if (quote == '\0' && (*ptr == '\n' || (*ptr == '#'
+							 && ptr > start
+							 && isblank(ptr[-1]))))
+		{
+			break;
+		} else if (*ptr == quote) {
+			break;
+		} else if (quote == '"' && *ptr == '\\' && ptr + 1 < end) {
+			c = *++ptr == 'n' ? '\n' : *ptr;
+			if (append_buffer(value, &c, 1) < 0) {
+				err(EXIT_FAILURE, "malloc failed");
+			}
+			continue;
+		}
+		if (append_buffer(value, ptr, 1) < 0) {
+			err(EXIT_FAILURE, "malloc failed");
+		}
+	}
+
+	if (quote != '\0') {
+		if (ptr == end) {
+			return NULL;
+		}
+		ptr = memchr(ptr, '\n', end - ptr);
+		return ptr == NULL ? end : ptr + 1;
+	}
+	// Unquoted values end before the blanks of a comment or the line
+	while (value->len > 0 && isblank(value->data[value->len - 1])) {
+		value->data[--value->len] = '\0';
+	}
+	ptr = memchr(ptr, '\n', end - ptr);
+	return ptr == NULL ? end : ptr + 1;
+}
+
 int
 add_env(const char *line)
 {
@@ -86,43 +274,54 @@ add_env(const char *line)
 			return usage();
 		}
 		// Set environment variables
-		setenv(line, p, 1);
+		switch (set_var(line, p, VAR_EXPORTED)) {
+		case -1:
+			dprintf(err_fd,
+				"mash: export: `%s': not a valid identifier\n",
+				line);
+			return EXIT_FAILURE;
+		case -2:
+			return EXIT_FAILURE;
+		}
 		return 0;
 	}
-	return 1;
+	// Only mark an existing variable, an unset one has nothing to export
+	if (set_var_flags(line, VAR_EXPORTED) == -1) {
+		dprintf(err_fd, "mash: export: `%s': not a valid identifier\n",
+			line);
+		return EXIT_FAILURE;
+	}
+	return 0;
 }
 
 int
 add_env_by_name(const char *key, const char *value)
 {
-	return setenv(key, value, 1);
+	return set_var(key, value, 0);
 }
 
 char *
 get_env_by_name(const char *key)
 {
-	char *env = malloc(MAX_ENV_SIZE);
-
-	if (env == NULL) {
-		err(EXIT_FAILURE, "error maloc failed");
-	}
-	memset(env, 0, MAX_ENV_SIZE);
-	char *ret = getenv(key);
+	char *ret = get_var(key);
+	char *env;
 
 	if (ret == NULL) {
-		free(env);
 		return NULL;
 	}
-	strcpy(env, ret);
+	env = strdup(ret);
+	if (env == NULL) {
+		err(EXIT_FAILURE, "error maloc failed");
+	}
 	return env;
 }
 
 void
 print_env()
 {
-	char **s = environ;
+	char **s = get_envp();
 
 	for (; *s; s++) {
-		dprintf(out_fd, "%s\n", *s);
+		dprintf_buffered(out_fd, "%s\n", *s);
 	}
 }
@@ -21,6 +21,9 @@
 #include "builtin/command.h"
 #include "builtin/disown.h"
 #include "builtin/echo.h"
+#include "builtin/exec.h"
+#include "builtin/declare.h"
+#include "builtin/mapfile.h"
 #include "builtin/exit.h"
 #include "builtin/export.h"
 #include "builtin/fg.h"
@@ -109,6 +112,10 @@ print_usage(char *name)
 		printf("command: %s\n", command_use);
 		matched++;
 	}
+	if (name == NULL || strncmp("declare", name, strlen(name)) == 0) {
+		printf("declare: %s\n", declare_use);
+		matched++;
+	}
 	if (name == NULL || strncmp("disown", name, strlen(name)) == 0) {
 		printf("disown: %s\n", disown_use);
 		matched++;
@@ -117,6 +124,10 @@ print_usage(char *name)
 		printf("echo: %s\n", echo_use);
 		matched++;
 	}
+	if (name == NULL || strncmp("exec", name, strlen(name)) == 0) {
+		printf("exec: %s\n", exec_use);
+		matched++;
+	}
 	if (name == NULL || strncmp("exit", name, strlen(name)) == 0) {
 		printf("exit: %s\n", exit_use);
 		matched++;
@@ -149,6 +160,10 @@ print_usage(char *name)
 		printf("kill: %s\n", kill_use);
 		matched++;
 	}
+	if (name == NULL || strncmp("mapfile", name, strlen(name)) == 0) {
+		printf("mapfile: %s\n", mapfile_use);
+		matched++;
+	}
 	if (name == NULL || strncmp("math", name, strlen(name)) == 0) {
 		printf("math: %s\n", math_use);
 		matched++;
@@ -157,6 +172,10 @@ print_usage(char *name)
 		printf("pwd: %s\n", pwd_use);
 		matched++;
 	}
+	if (name == NULL || strncmp("readarray", name, strlen(name)) == 0) {
+		printf("readarray: %s\n", readarray_use);
+		matched++;
+	}
 	if (name == NULL || strncmp("sleep", name, strlen(name)) == 0) {
 		printf("sleep: %s\n", sleep_use);
 		matched++;
@@ -165,6 +184,10 @@ print_usage(char *name)
 		printf("source: %s\n", source_use);
 		matched++;
 	}
+	if (name == NULL || strncmp("unalias", name, strlen(name)) == 0) {
+		printf("unalias: %s\n", unalias_use);
+		matched++;
+	}
 	if (name == NULL || strncmp("wait", name, strlen(name)) == 0) {
 		printf("wait: %s\n", wait_use);
 		matched++;
@@ -204,6 +227,10 @@ print_description(char *name)
 		printf("command - %s\n", command_description);
 		matched++;
 	}
+	if (strncmp("declare", name, strlen(name)) == 0) {
+		printf("declare - %s\n", declare_description);
+		matched++;
+	}
 	if (strncmp("disown", name, strlen(name)) == 0) {
 		printf("disown - %s\n", disown_description);
 		matched++;
@@ -212,6 +239,10 @@ print_description(char *name)
 		printf("echo - %s\n", echo_description);
 		matched++;
 	}
+	if (strncmp("exec", name, strlen(name)) == 0) {
+		printf("exec - %s\n", exec_description);
+		matched++;
+	}
 	if (strncmp("exit", name, strlen(name)) == 0) {
 		printf("exit - %s\n", exit_description);
 		matched++;
@@ -244,6 +275,10 @@ print_description(char *name)
 		printf("kill - %s\n", kill_description);
 		matched++;
 	}
+	if (strncmp("mapfile", name, strlen(name)) == 0) {
+		printf("mapfile - %s\n", mapfile_description);
+		matched++;
+	}
 	if (strncmp("math", name, strlen(name)) == 0) {
 		printf("math - %s\n", math_description);
 		matched++;
@@ -252,6 +287,10 @@ print_description(char *name)
 		printf("pwd - %s\n", pwd_description);
 		matched++;
 	}
+	if (strncmp("readarray", name, strlen(name)) == 0) {
+		printf("readarray - %s\n", readarray_description);
+		matched++;
+	}
 	if (strncmp("sleep", name, strlen(name)) == 0) {
 		printf("sleep - %s\n", sleep_description);
 		matched++;
@@ -260,6 +299,10 @@ print_description(char *name)
 		printf("source - %s\n", source_description);
 		matched++;
 	}
+	if (strncmp("unalias", name, strlen(name)) == 0) {
+		printf("unalias - %s\n", unalias_description);
+		matched++;
+	}
 	if (strncmp("wait", name, strlen(name)) == 0) {
 		printf("wait - %s\n", wait_description);
 		matched++;
@@ -319,6 +362,13 @@ print_default_help(char *name)
 		help_str[n_matches] = command_help;
 		n_matches++;
 	}
+	if (strncmp("declare", name, strlen(name)) == 0) {
+		builtin[n_matches] = "declare";
+		use[n_matches] = declare_use;
+		description[n_matches] = declare_description;
+		help_str[n_matches] = declare_help;
+		n_matches++;
+	}
 	if (strncmp("disown", name, strlen(name)) == 0) {
 		builtin[n_matches] = "disown";
 		use[n_matches] = disown_use;
@@ -333,6 +383,13 @@ print_default_help(char *name)
 		help_str[n_matches] = echo_help;
 		n_matches++;
 	}
+	if (strncmp("exec", name, strlen(name)) == 0) {
+		builtin[n_matches] = "exec";
+		use[n_matches] = exec_use;
+		description[n_matches] = exec_description;
+		help_str[n_matches] = exec_help;
+		n_matches++;
+	}
 	if (strncmp("exit", name, strlen(name)) == 0) {
 		builtin[n_matches] = "exit";
 		use[n_matches] = exit_use;
@@ -389,6 +446,13 @@ print_default_help(char *name)
 		help_str[n_matches] = kill_help;
 		n_matches++;
 	}
+	if (strncmp("mapfile", name, strlen(name)) == 0) {
+		builtin[n_matches] = "mapfile";
+		use[n_matches] = mapfile_use;
+		description[n_matches] = mapfile_description;
+		help_str[n_matches] = mapfile_help;
+		n_matches++;
+	}
 	if (strncmp("math", name, strlen(name)) == 0) {
 		builtin[n_matches] = "math";
 		use[n_matches] = math_use;
@@ -403,6 +467,13 @@ print_default_help(char *name)
 		help_str[n_matches] = pwd_help;
 		n_matches++;
 	}
+	if (strncmp("readarray", name, strlen(name)) == 0) {
+		builtin[n_matches] = "readarray";
+		use[n_matches] = readarray_use;
+		description[n_matches] = readarray_description;
+		help_str[n_matches] = readarray_help;
+		n_matches++;
+	}
 	if (strncmp("sleep", name, strlen(name)) == 0) {
 		builtin[n_matches] = "sleep";
 		use[n_matches] = sleep_use;
@@ -417,6 +488,13 @@ print_default_help(char *name)
 		help_str[n_matches] = source_help;
 		n_matches++;
 	}
+	if (strncmp("unalias", name, strlen(name)) == 0) {
+		builtin[n_matches] = "unalias";
+		use[n_matches] = unalias_use;
+		description[n_matches] = unalias_description;
+		help_str[n_matches] = unalias_help;
+		n_matches++;
+	}
 	if (strncmp("wait", name, strlen(name)) == 0) {
 		builtin[n_matches] = "wait";
 		use[n_matches] = wait_use;
@@ -483,6 +561,13 @@ print_help_man(char *name)
 		help_str[n_matches] = command_help;
 		n_matches++;
 	}
+	if (strncmp("declare", name, strlen(name)) == 0) {
+		builtin[n_matches] = "declare";
+		use[n_matches] = declare_use;
+		description[n_matches] = declare_description;
+		help_str[n_matches] = declare_help;
+		n_matches++;
+	}
 	if (strncmp("disown", name, strlen(name)) == 0) {
 		builtin[n_matches] = "disown";
 		use[n_matches] = disown_use;
@@ -497,6 +582,13 @@ print_help_man(char *name)
 		help_str[n_matches] = echo_help;
 		n_matches++;
 	}
+	if (strncmp("exec", name, strlen(name)) == 0) {
+		builtin[n_matches] = "exec";
+		use[n_matches] = exec_use;
+		description[n_matches] = exec_description;
+		help_str[n_matches] = exec_help;
+		n_matches++;
+	}
 	if (strncmp("exit", name, strlen(name)) == 0) {
 		builtin[n_matches] = "exit";
 		use[n_matches] = exit_use;
@@ -553,6 +645,13 @@ print_help_man(char *name)
 		help_str[n_matches] = kill_help;
 		n_matches++;
 	}
+	if (strncmp("mapfile", name, strlen(name)) == 0) {
+		builtin[n_matches] = "mapfile";
+		use[n_matches] = mapfile_use;
+		description[n_matches] = mapfile_description;
+		help_str[n_matches] = mapfile_help;
+		n_matches++;
+	}
 	if (strncmp("math", name, strlen(name)) == 0) {
 		builtin[n_matches] = "math";
 		use[n_matches] = math_use;
@@ -567,6 +666,13 @@ print_help_man(char *name)
 		help_str[n_matches] = pwd_help;
 		n_matches++;
 	}
+	if (strncmp("readarray", name, strlen(name)) == 0) {
+		builtin[n_matches] = "readarray";
+		use[n_matches] = readarray_use;
+		description[n_matches] = readarray_description;
+		help_str[n_matches] = readarray_help;
+		n_matches++;
+	}
 	if (strncmp("sleep", name, strlen(name)) == 0) {
 		builtin[n_matches] = "sleep";
 		use[n_matches] = sleep_use;
@@ -581,6 +687,13 @@ print_help_man(char *name)
 		help_str[n_matches] = source_help;
 		n_matches++;
 	}
+	if (strncmp("unalias", name, strlen(name)) == 0) {
+		builtin[n_matches] = "unalias";
+		use[n_matches] = unalias_use;
+		description[n_matches] = unalias_description;
+		help_str[n_matches] = unalias_help;
+		n_matches++;
+	}
 	if (strncmp("wait", name, strlen(name)) == 0) {
 		builtin[n_matches] = "wait";
 		use[n_matches] = wait_use;
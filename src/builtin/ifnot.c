@@ -17,6 +17,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "builtin/command.h"
+#include "mash.h"
 #include "builtin/ifnot.h"
 
 char *ifnot_use = "ifnot command [arg ..]";
@@ -25,8 +26,7 @@ char *ifnot_help =
     "    Runs COMMAND with ARGS if the last executed command finished with\n"
     "    failure.\n\n"
     "    Exit Status:\n"
-    "    Returns exit status of COMMAND, or success if last command ended with success.\n"
-    "    If enviroment variable 'result' does not exist returns failure.\n";
+    "    Returns exit status of COMMAND, or success if last command ended with success.\n";
 
 static int
 help()
@@ -47,13 +47,6 @@ int
 ifnot(Command * command)
 {
 	int i;
-	char *result = getenv("result");
-
-	if (result == NULL) {
-		fprintf(stderr, "error: var result does not exist");
-		return CMD_EXIT_FAILURE;
-	}
-
 	if (command->argc < 2) {
 		return usage();
 	}
@@ -64,7 +57,7 @@ ifnot(Command * command)
 		}
 	}
 
-	if (atoi(result) != 0) {
+	if (last_status != 0) {
 		for (i = 1; i < command->argc; i++) {
 			strcpy(command->argv[i - 1], command->argv[i]);
 		}
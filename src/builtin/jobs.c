@@ -20,6 +20,7 @@
 #include <termios.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <err.h>
 #include <errno.h>
@@ -27,6 +28,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "open_files.h"
+#include "variables.h"
 #include "builtin/command.h"
 #include "builtin/builtin.h"
 #include "builtin/export.h"
@@ -38,6 +40,7 @@
 #include "parse_line.h"
 #include "mash.h"
 #include "exec_cmd.h"
+#include "multio.h"
 #include "builtin/jobs.h"
 
 char *jobs_use = "jobs [-lprs] [jobspec]";
@@ -245,6 +248,11 @@ launch_job(FILE * src_file, ExecInfo * exec_info, char *to_free_excess)
 		}
 	}
 
+	if (has_builtin_exec_in_buffer(cmd)) {
+		close_all_fd_no_fork(cmd);
+		return exec_builtin_in_buffer(cmd);
+	}
+
 	Job *job = new_job(exec_info->line);
 
 	if (cmd->search_location != SEARCH_CMD_ONLY_COMMAND &&
@@ -253,8 +261,14 @@ launch_job(FILE * src_file, ExecInfo * exec_info, char *to_free_excess)
 	    has_builtin_exec_in_shell(cmd)) {
 		free(job->command);
 		free(job);
+		prepare_multio(cmd);
+		start_multio(cmd);
+		int exit_code = exec_builtin_in_shell(cmd, 0);
+
+		end_multio(cmd, 1);
+		// Input is only closed once builtins like mapfile read it
 		close_all_fd_no_fork(cmd);
-		return exec_builtin_in_shell(cmd, 0);
+		return exit_code;
 	}
 
 	if (cmd->do_wait == DO_NOT_WAIT_TO_FINISH) {
@@ -288,6 +302,8 @@ exec_job(FILE * src_file, ExecInfo * exec_info, Job * job, char *to_free_excess)
 	    || set_output_shell_pipe(exec_info->command)) {
 		return 1;
 	}
+	prepare_multio(exec_info->command);
+	exec_info->command->envp = get_envp();
 	// Make a loop fork each command
 	for (cmd = exec_info->command; cmd; cmd = cmd->pipe_next) {
 		cmd->pid = fork();
@@ -299,6 +315,7 @@ exec_job(FILE * src_file, ExecInfo * exec_info, Job * job, char *to_free_excess)
 	switch (cmd->pid) {
 	case -1:
 		close_all_fd(exec_info->command);
+		end_multio(exec_info->command, 0);
 		remove_job(job);
 		fprintf(stderr, "mash: failed to fork");
 		return EXIT_FAILURE;
@@ -332,14 +349,24 @@ exec_job(FILE * src_file, ExecInfo * exec_info, Job * job, char *to_free_excess)
 		job->end_pid = exec_info->last_command->pid;
 		close(null);
 		close_all_fd_io(exec_info->command, cmd);
+		start_multio(exec_info->command);
+		pid_t job_pid = job->pid;
+		int exit_code;
+
 		switch (job->execution) {
 		case BACKGROUND:
-			return wait_job_background(job, exec_info->command);
+			exit_code = wait_job_background(job, exec_info->command);
+			break;
 		case SUB_EXECUTION:
-			return wait_job_subexec(job, exec_info->command);
+			exit_code = wait_job_subexec(job, exec_info->command);
+			break;
 		default:
-			return wait_job_foreground(job, exec_info->command);
+			exit_code = wait_job_foreground(job, exec_info->command);
+			break;
 		}
+		// Only finished jobs have written all their outputs
+		end_multio(exec_info->command, get_job(job_pid) == NULL);
+		return exit_code;
 	}
 	return EXIT_FAILURE;
 }
@@ -754,7 +781,10 @@ update_jobs()
 	for (current = jobs_list.head; current; current = current->next_job) {
 		if (waitpid(current->pid, 0, WNOHANG) < 0) {
 			current->state = DONE;
-			print_job(current, 0);
+			// Process substitutions end silently
+			if (current->execution != SUB_EXECUTION) {
+				print_job(current, 0);
+			}
 		}
 	}
 	remove_all_status_jobs(DONE);
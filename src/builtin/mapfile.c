@@ -0,0 +1,188 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <err.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "buffer.h"
+#include "variables.h"
+#include "builtin/mapfile.h"
+
+// DECLARE GLOBAL VARIABLE
+char *mapfile_use = "mapfile [-t] [-n count] [array]";
+char *mapfile_description =
+    "Read lines from the standard input into an indexed array variable.";
+char *mapfile_help =
+    "    Read lines from the standard input into the indexed array variable\n"
+    "    ARRAY.  The variable MAPFILE is the default ARRAY.\n\n"
+    "    Options:\n"
+    "      -n count	Copy at most COUNT lines.  If COUNT is 0, all lines are\n"
+    "    		copied\n"
+    "      -t	Remove a trailing newline from each line read\n\n"
+    "    The whole input is read before the lines are split.\n\n"
+    "    Exit Status:\n"
+    "    Returns success unless an invalid option is given, ARRAY is invalid or\n"
+    "    the input can not be read.\n";
+char *readarray_use = "readarray [-t] [-n count] [array]";
+char *readarray_description = "Read lines from a file into an array variable.";
+char *readarray_help = "    A synonym for `mapfile'.\n";
+
+static int out_fd;
+static int err_fd;
+
+// DECLARE STATIC FUNCTIONS
+static int help();
+static int usage();
+static size_t count_lines(const char *data, size_t len, long max_lines);
+static int load_lines(const char *name, int fd, long max_lines, int trim);
+
+static int
+help()
+{
+	dprintf(out_fd, "mapfile: %s\n", mapfile_use);
+	dprintf(out_fd, "    %s\n\n%s", mapfile_description, mapfile_help);
+	return EXIT_SUCCESS;
+}
+
+static int
+usage()
+{
+	dprintf(err_fd, "Usage: %s\n", mapfile_use);
+	return EXIT_FAILURE;
+}
+
+// Only the first max_lines lines, all of them if it is 0
+static size_t
+count_lines(const char *data, size_t len, long max_lines)
+{
+	const char *end = data + len;
+	const char *eol;
+	size_t n_lines = 0;
+
+	while (data < end && (max_lines == 0 || n_lines < (size_t)max_lines)) {
+		eol = memchr(data, '\n', end - data);
+		data = eol == NULL ? end : eol + 1;
+		n_lines++;
+	}
+	return n_lines;
+}
+
+static int
+load_lines(const char *name, int fd, long max_lines, int trim)
+{
+	Buffer *buffer = new_buffer();
+	char **elements;
+	char *block;
+	char *line;
+	char *eol;
+	char *end;
+	char *ptr;
+	size_t n_lines;
+	size_t block_size;
+	size_t i;
+
+	if (read_to_buffer(buffer, fd) < 0) {
+		free_buffer(buffer);
+		dprintf(err_fd, "mash: mapfile: read failed\n");
+		return EXIT_FAILURE;
+	}
+
+	n_lines = count_lines(buffer->data, buffer->len, max_lines);
+	elements = malloc((n_lines + 1) * sizeof(char *));
+	if (elements == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+
+	if (trim) {
+		// Every '\n' becomes the end of its line, the block is the input
+		block = buffer->data;
+		block_size = buffer->len + 1;
+		end = block + buffer->len;
+		buffer->data = NULL;
+		for (i = 0, line = block; i < n_lines; i++) {
+			elements[i] = line;
+			eol = memchr(line, '\n', end - line);
+			if (eol == NULL) {
+				break;
+			}
+			*eol = '\0';
+			line = eol + 1;
+		}
+	} else {
+		// One more byte for the end of each line
+		block_size = buffer->len + n_lines + 1;
+		block = malloc(block_size);
+		if (block == NULL) {
+			err(EXIT_FAILURE, "malloc failed");
+		}
+		end = buffer->data + buffer->len;
+		for (i = 0, line = buffer->data, ptr = block; i < n_lines; i++) {
+			eol = memchr(line, '\n', end - line);
+			eol = eol == NULL ? end : eol + 1;
+			elements[i] = ptr;
+			memcpy(ptr, line, eol - line);
+			ptr += eol - line;
+			*ptr++ = '\0';
+			line = eol;
+		}
+	}
+	free_buffer(buffer);
+
+	if (load_array(name, block, block_size, elements, n_lines) < 0) {
+		free(block);
+		free(elements);
+		dprintf(err_fd, "mash: mapfile: `%s': not a valid identifier\n",
+			name);
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
+
+int
+mapfile(int argc, char *argv[], int stdin_fd, int stdout_fd, int stderr_fd)
+{
+	argc--;
+	argv++;
+	long max_lines = 0;
+	int trim = 0;
+	char *end;
+	int i;
+
+	out_fd = stdout_fd;
+	err_fd = stderr_fd;
+
+	if (argc == 1 && strcmp(argv[0], "--help") == 0) {
+		return help();
+	}
+
+	for (i = 0; i < argc && argv[i][0] == '-'; i++) {
+		if (strcmp(argv[i], "-t") == 0) {
+			trim = 1;
+		} else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			max_lines = strtol(argv[++i], &end, 10);
+			if (*end != '\0' || end == argv[i] || max_lines < 0) {
+				return usage();
+			}
+		} else {
+			return usage();
+		}
+	}
+	if (argc - i > 1) {
+		return usage();
+	}
+
+	return load_lines(i < argc ? argv[i] : "MAPFILE", stdin_fd, max_lines,
+			  trim);
+}
@@ -16,8 +16,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <math.h>
-#include "builtin/export.h"
+#include <limits.h>
+#include "variables.h"
+#include "buffer.h"
 #include "builtin/mash_math.h"
 
 char *math_use = "math expression";
@@ -28,22 +29,30 @@ char *math_help =
     "    Exit Status:\n"
     "    Returns success unless an error in the expression is found.\n";
 
+static int out_fd;
+static int err_fd;
+
 static int
 help()
 {
-	printf("math: %s\n", math_use);
-	printf("    %s\n\n%s", math_description, math_help);
+	dprintf_buffered(out_fd, "math: %s\n", math_use);
+	dprintf_buffered(out_fd, "    %s\n\n%s", math_description, math_help);
 	return EXIT_SUCCESS;
 }
 
 static int
 usage()
 {
-	fprintf(stderr, "Usage: %s\n", math_use);
+	dprintf(err_fd, "Usage: %s\n", math_use);
 	return EXIT_FAILURE;
 }
 
 // STATIC FUNCTIONS FOR BUILTIN
+enum math_error {
+	MATH_DIVISION_BY_ZERO = 1,
+	MATH_NEGATIVE_EXPONENT
+};
+
 static int error_in_operations = 0;
 
 enum lexer_type {
@@ -58,7 +67,8 @@ enum math_size {
 
 struct token {
 	char data[MAX_OPERAND_SIZE];
-	double value;
+	// Operations are done in 64 bits, like the integer variables
+	long long value;
 	int type;
 	int priority;
 	int symbol_priority;
@@ -116,19 +126,21 @@ is_symbol(char c)
 	return c == '+' || c == '-' || c == '*' || c == '/' || c == '^';
 }
 
-static double
-get_number(char *number)
+// Returns -1 if it is not a number or it does not fit in a long long
+static int
+get_number(char *number, long long *value)
 {
-	double num = 0;
+	long long num = 0;
 
 	for (; *number != '\0'; number++) {
-		if (*number >= '0' && *number <= '9') {
-			num = num * 10 + (*number - '0');
-		} else {
+		if (*number < '0' || *number > '9'
+		    || num > (LLONG_MAX - (*number - '0')) / 10) {
 			return -1;
 		}
+		num = num * 10 + (*number - '0');
 	}
-	return num;
+	*value = num;
+	return 0;
 }
 
 static Token *
@@ -140,7 +152,11 @@ tokenize(char *expression)
 	char *line = expression;
 
 	for (; *expression != '\0'; expression++) {
-		if (*expression >= '0' && *expression <= '9') {
+		if (*expression >= '0' && *expression <= '9'
+		    && current_token->type == MATH_VARIABLE) {
+			// Part of a name: i2
+			strncat(current_token->data, expression, 1);
+		} else if (*expression >= '0' && *expression <= '9') {
 			if (current_token->type != MATH_NUMBER
 			    && current_token->type) {
 				current_token =
@@ -150,7 +166,8 @@ tokenize(char *expression)
 			strncat(current_token->data, expression, 1);
 			current_token->type = MATH_NUMBER;
 		} else if ((*expression >= 'a' && *expression <= 'z') ||
-			   (*expression >= 'A' && *expression <= 'Z')) {
+			   (*expression >= 'A' && *expression <= 'Z')
+			   || *expression == '_') {
 			if (current_token->type != MATH_VARIABLE
 			    && current_token->type) {
 				current_token =
@@ -162,7 +179,7 @@ tokenize(char *expression)
 		} else if (is_symbol(*expression)) {
 			if (!current_token->type) {
 				if (*expression != '-' && *expression != '+') {
-					fprintf(stderr,
+					dprintf(err_fd,
 						"mash: error: math: incorrect character '%c' at the beginning of expression '%s'\n",
 						*expression, line);
 					free_all_tokens(first_token);
@@ -181,7 +198,7 @@ tokenize(char *expression)
 			total_priority++;
 		} else if (*expression == ')') {
 			if (!current_token->type) {
-				fprintf(stderr,
+				dprintf(err_fd,
 					"mash: error: math: incorrect character '%c' in expression '%s'\n",
 					*expression, line);
 				free_all_tokens(first_token);
@@ -189,7 +206,7 @@ tokenize(char *expression)
 			}
 			total_priority--;
 		} else if (*expression != ' ' && *expression != '\t') {
-			fprintf(stderr,
+			dprintf(err_fd,
 				"mash: error: math: incorrect character '%c' in expression '%s'\n",
 				*expression, line);
 			free_all_tokens(first_token);
@@ -197,13 +214,13 @@ tokenize(char *expression)
 		}
 	}
 	if (total_priority != 0) {
-		fprintf(stderr,
+		dprintf(err_fd,
 			"mash: error: math: incorrect expression '%s'\n", line);
 		free_all_tokens(first_token);
 		return NULL;
 	}
 	if (current_token->type == MATH_SYMBOL) {
-		fprintf(stderr,
+		dprintf(err_fd,
 			"mash: error: math: incorrect symbol '%s' at the end of expression\n",
 			line);
 		free_all_tokens(first_token);
@@ -216,54 +233,39 @@ static int
 substitute_values(Token *first_token)
 {
 	Token *token, *prev_token, *to_free;
-	char *variable;
-	double value;
+	long long value;
 	int prev_is_symbol = -1;
 
 	for (token = first_token; token; token = token->next) {
 		switch (token->type) {
 		case MATH_NUMBER:
 			if (!prev_is_symbol) {
-				fprintf(stderr, "mash: error:");
+				dprintf(err_fd, "mash: error:");
 				return -1;
 			}
 			prev_is_symbol = 0;
-			if ((value = get_number(token->data)) < 0) {
+			if (get_number(token->data, &value) < 0) {
 				return -1;
 			}
-			token->value *= value;
+			token->value = (long long)((unsigned long long)
+						    token->value * value);
 			break;
 		case MATH_VARIABLE:
 			if (!prev_is_symbol) {
 				return -1;
 			}
 			prev_is_symbol = 0;
-			variable = get_env_by_name(token->data);
-			if (variable == NULL) {
-				fprintf(stderr,
-					"mash: error: var %s does not exist\n",
-					token->data);
-				return -1;
-			}
-
-			if (*variable == '-') {
-				token->value *= -1;
-				variable++;
-				strcpy(token->data, variable);
-				variable--;
-			} else if (*variable == '+') {
-				variable++;
-				strcpy(token->data, variable);
-				variable--;
-			} else {
-				strcpy(token->data, variable);
-			}
-
-			free(variable);
-			if ((value = get_number(token->data)) < 0) {
+			// Integer variables are used without a string
+			if (get_var_int(token->data, &value) < 0) {
+				if (get_var(token->data) == NULL) {
+					dprintf(err_fd,
+						"mash: error: var %s does not exist\n",
+						token->data);
+				}
 				return -1;
 			}
-			token->value *= value;
+			token->value = (long long)((unsigned long long)
+						    token->value * value);
 			token->type = MATH_NUMBER;
 			break;
 		default:
@@ -299,34 +301,51 @@ substitute_values(Token *first_token)
 	return 0;
 }
 
-static double
-calculate(char symbol, double op_1, double op_2)
+// Overflows wrap around, like in other shells
+static long long
+calculate(char symbol, long long op_1, long long op_2)
 {
+	unsigned long long base = op_1;
+	unsigned long long result = 1;
+
 	switch (symbol) {
 	case '*':
-		return op_1 * op_2;
+		return (long long)((unsigned long long)op_1 * op_2);
 		break;
 	case '+':
-		return op_1 + op_2;
+		return (long long)((unsigned long long)op_1 + op_2);
 		break;
 	case '-':
-		return op_1 - op_2;
+		return (long long)((unsigned long long)op_1 - op_2);
 		break;
 	case '/':
 		if (op_2 == 0) {
-			error_in_operations = 1;
+			error_in_operations = MATH_DIVISION_BY_ZERO;
 			return 0;
 		}
+		if (op_2 == -1) {
+			return (long long)(0 - (unsigned long long)op_1);
+		}
 		return op_1 / op_2;
 		break;
 	case '^':
-		return pow(op_1, op_2);
+		if (op_2 < 0) {
+			error_in_operations = MATH_NEGATIVE_EXPONENT;
+			return 0;
+		}
+		for (; op_2 > 0; op_2 >>= 1) {
+			if (op_2 & 1) {
+				result *= base;
+			}
+			base *= base;
+		}
+		return (long long)result;
 		break;
 	}
 	return 0;
 }
 
-static double
+static long long
 do_operations(Token *start_token)
 {
 	// num sim1 num2 sim2 num3 sim3 num4
@@ -338,7 +357,7 @@ do_operations(Token *start_token)
 	Token *token = start_token;
 	Token *prev_op = token;
 	int symbol_p = -1;
-	double result = 0;
+	long long result = 0;
 
 	if (start_token->next == NULL) {
 		result = start_token->value;
@@ -416,7 +435,7 @@ do_operations(Token *start_token)
 	return result;
 }
 
-static double
+static long long
 operate(Token *start_token)
 {
 	// Operate on the highest priority token
@@ -449,11 +468,14 @@ operate(Token *start_token)
 }
 
 int
-math(int argc, char *argv[])
+math(int argc, char *argv[], int stdout_fd, int stderr_fd)
 {
 	argc--;
 	argv++;
-	double result;
+	long long result;
+
+	out_fd = stdout_fd;
+	err_fd = stderr_fd;
 
 	if (argc != 1) {
 		return usage();
@@ -463,29 +485,50 @@ math(int argc, char *argv[])
 		return help();
 	}
 
-	Token *first_token = tokenize(argv[0]);
+	if (eval_math(argv[0], &result, err_fd) < 0) {
+		return EXIT_FAILURE;
+	}
+
+	dprintf_buffered(out_fd, "%lld\n", result);
+	return EXIT_SUCCESS;
+}
+
+int
+eval_math(char *expression, long long *result, int error_fd)
+{
+	Token *first_token;
+	long long value;
+
+	err_fd = error_fd;
+	first_token = tokenize(expression);
 
 	if (first_token == NULL) {
-		return EXIT_FAILURE;
+		return -1;
 	}
 
 	if (substitute_values(first_token) != 0) {
-		fprintf(stderr,
+		dprintf(err_fd,
 			"mash: error: math: incorrect expression '%s'\n",
-			argv[0]);
+			expression);
 		free_all_tokens(first_token);
-		return EXIT_FAILURE;
+		return -1;
 	}
 
-	result = operate(first_token);
+	value = operate(first_token);
 
-	if (error_in_operations) {
+	if (error_in_operations == MATH_DIVISION_BY_ZERO) {
 		error_in_operations = 0;
-		fprintf(stderr, "mash: error: math: division by 0 in '%s'\n",
-			argv[0]);
-		return EXIT_FAILURE;
+		dprintf(err_fd, "mash: error: math: division by 0 in '%s'\n",
+			expression);
+		return -1;
+	} else if (error_in_operations == MATH_NEGATIVE_EXPONENT) {
+		error_in_operations = 0;
+		dprintf(err_fd,
+			"mash: error: math: negative exponent in '%s'\n",
+			expression);
+		return -1;
 	}
 
-	printf("%d\n", (int)result);
-	return EXIT_SUCCESS;
+	*result = value;
+	return 0;
 }
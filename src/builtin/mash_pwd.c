@@ -17,6 +17,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include "variables.h"
+#include "buffer.h"
 #include "builtin/mash_pwd.h"
 
 char *pwd_use = "pwd";
@@ -25,28 +27,34 @@ char *pwd_help =
     "    Exit Status:\n"
     "    Returns 0 unless an invalid option is given or the current directory cannot be read.\n";
 
+static int out_fd;
+static int err_fd;
+
 static int
 help()
 {
-	printf("pwd: %s\n", pwd_use);
-	printf("    %s\n\n%s", pwd_description, pwd_help);
+	dprintf_buffered(out_fd, "pwd: %s\n", pwd_use);
+	dprintf_buffered(out_fd, "    %s\n\n%s", pwd_description, pwd_help);
 	return EXIT_SUCCESS;
 }
 
 static int
 usage()
 {
-	fprintf(stderr, "Usage: %s\n", pwd_use);
+	dprintf(err_fd, "Usage: %s\n", pwd_use);
 	return EXIT_FAILURE;
 }
 
 int
-pwd(int argc, char *argv[])
+pwd(int argc, char *argv[], int stdout_fd, int stderr_fd)
 {
 	argc--;
 	argv++;
 	char *pwd;
 
+	out_fd = stdout_fd;
+	err_fd = stderr_fd;
+
 	if (argc == 1) {
 		if (strcmp(argv[0], "--help") == 0) {
 			return help();
@@ -57,13 +65,13 @@ pwd(int argc, char *argv[])
 		return usage();
 	}
 
-	if ((pwd = getenv("PWD")) == NULL) {
-		fprintf(stderr,
+	if ((pwd = get_var("PWD")) == NULL) {
+		dprintf(err_fd,
 			"mash: pwd: failed to get current working directory\n");
 		return EXIT_FAILURE;
 	}
 
-	printf("%s\n", pwd);
+	dprintf_buffered(out_fd, "%s\n", pwd);
 
 	return EXIT_SUCCESS;
 }
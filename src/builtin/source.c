@@ -15,30 +15,81 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <err.h>
 #include <errno.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include "buffer.h"
+#include "variables.h"
+#include "open_files.h"
 #include "builtin/command.h"
 #include "builtin/export.h"
 #include "builtin/alias.h"
 #include "parse.h"
 #include "exec_info.h"
 #include "parse_line.h"
+#include "mash.h"
+#include "builtin/exit.h"
 #include "builtin/source.h"
+#include "script_cache.h"
+
+// A file is the same while its device, inode and modification time match
+struct sourced_file {
+	// Only kept for the files already sourced
+	char *path;
+	dev_t dev;
+	ino_t ino;
+	struct timespec mtime;
+};
+
+// A script being run, its lines are taken from memory
+struct script {
+	const char *data;
+	size_t size;
+	size_t pos;
+	// data holds the records of a compiled script instead of its text
+	int compiled;
+	// Script that sourced this one
+	struct script *prev;
+};
+
+// DECLARE STATIC FUNCTIONS
+static int find_sourced(struct sourced_file *files, size_t n,
+			const struct stat *st, int match_mtime);
+static int run_compiled_line(struct script *script, char *buf);
+static void add_sourced(struct sourced_file **files, size_t *n,
+			size_t *size, const char *path,
+			const struct stat *st);
 
 // DECLARE GLOBAL VARIABLE
-char *source_use = "source filename";
+char *source_use = "source [-o] filename";
 char *source_description = "Execute commands from a file in the current shell.";
 char *source_help =
     "    Read and execute commands from FILENAME in the current shell.  The\n"
     "    entries in $PATH are used to find the directory containing FILENAME.\n\n"
+    "    Options:\n"
+    "      -o	do nothing if FILENAME was already sourced and has not\n"
+    "    		changed since then\n\n"
     "    Exit Status:\n"
-    "    Returns success unless FILENAME cannot be read.\n";
+    "    Returns the status of the last command executed in FILENAME; fails if\n"
+    "    FILENAME cannot be read.\n";
 
-struct source_file *sources[MAX_SOURCE_FILES];
+// Every file sourced, checked by source -o
+static struct sourced_file *sourced;
+static size_t n_sourced;
+static size_t sourced_size;
+
+// Files being sourced, from the outermost to the innermost
+static struct sourced_file *running;
+static size_t n_running;
+static size_t running_size;
+
+// Innermost script being run, NULL while reading stdin
+static struct script *current_script;
 
 static int out_fd;
 static int err_fd;
@@ -63,201 +114,346 @@ source(int argc, char *argv[], int stdout_fd, int stderr_fd)
 {
 	argc--;
 	argv++;
+	int once = 0;
 
 	out_fd = stdout_fd;
 	err_fd = stderr_fd;
 
-	if (argc != 1) {
+	if (argc == 2 && strcmp(argv[0], "-o") == 0) {
+		once = 1;
+		argv++;
+	} else if (argc != 1) {
 		return usage();
-	}
-	if (strcmp(argv[0], "--help") == 0) {
+	} else if (strcmp(argv[0], "--help") == 0) {
 		return help();
 	}
 
-	return add_source(argv[0], stderr_fd);
+	return exec_source(argv[0], once, stderr_fd);
 }
 
-struct source_file *
-new_source_file(char *source_file_name)
+// The file runs before returning, it can source other files
+int
+exec_source(const char *source_file_name, int once, int error_fd)
 {
-	struct source_file *source_file =
-	    (struct source_file *)malloc(sizeof(struct source_file));
-	// Check if malloc failed
-	if (source_file == NULL) {
-		err(EXIT_FAILURE, "malloc failed");
+	struct stat st;
+	char *path = find_path_srcfile(source_file_name);
+	int status;
+
+	if (path == NULL || stat(path, &st) < 0) {
+		dprintf(error_fd, "Mash: source: %s no such file in directory\n",
+			source_file_name);
+		free(path);
+		return EXIT_FAILURE;
+	}
+	// A file sourcing itself, directly or not, would never end
+	if (find_sourced(running, n_running, &st, 0)) {
+		dprintf(error_fd, "Mash: source: %s: recursive source\n",
+			source_file_name);
+		free(path);
+		return EXIT_FAILURE;
+	}
+	if (find_sourced(sourced, n_sourced, &st, 1)) {
+		if (once) {
+			free(path);
+			return EXIT_SUCCESS;
+		}
+	} else {
+		add_sourced(&sourced, &n_sourced, &sourced_size, path, &st);
 	}
-	strcpy(source_file->file, source_file_name);
 
-	return source_file;
+	add_sourced(&running, &n_running, &running_size, NULL, &st);
+	if (read_source_file(path)) {
+		status = last_status;
+	} else {
+		dprintf(error_fd, "Mash: source: %s: %s\n", source_file_name,
+			strerror(errno));
+		status = EXIT_FAILURE;
+	}
+	n_running--;
+	free(path);
+	return status;
 }
 
-void
-free_source_file()
+const char *
+next_sourced_path(size_t *index)
 {
-	int i;
-
-	for (i = 0; i < MAX_SOURCE_FILES; i++) {
-		if (sources[i] == NULL) {
-			break;
-		}
-		free(sources[i]);
+	if (*index < n_sourced) {
+		return sourced[(*index)++].path;
 	}
+	return NULL;
 }
 
-int
-add_source(char *source_file_name, int error_fd)
+void
+free_sources()
 {
-	int index;
+	size_t i;
 
-	char *source_name = malloc(MAX_FILE_LENGTH);
-
-	if (source_name == NULL) {
-		err(EXIT_FAILURE, "malloc failed");
-	}
-	memset(source_name, 0, MAX_FILE_LENGTH);
-
-	strcpy(source_name, source_file_name);
-
-	if (!find_path_srcfile(source_name)) {
-		dprintf(err_fd, "Mash: source: %s no such file in directory\n",
-			source_file_name);
-		free(source_name);
-		return EXIT_FAILURE;
+	for (i = 0; i < n_sourced; i++) {
+		free(sourced[i].path);
 	}
+	free(sourced);
+	sourced = NULL;
+	n_sourced = 0;
+	sourced_size = 0;
+	free(running);
+	running = NULL;
+	n_running = 0;
+	running_size = 0;
+}
 
-	struct source_file *source_file = new_source_file(source_name);
-
-	free(source_name);
+static int
+find_sourced(struct sourced_file *files, size_t n, const struct stat *st,
+	     int match_mtime)
+{
+	size_t i;
 
-	for (index = 0; index < MAX_SOURCE_FILES; index++) {
-		if (sources[index] == NULL) {
-			sources[index] = source_file;
-			return 0;
+	for (i = 0; i < n; i++) {
+		if (files[i].ino == st->st_ino && files[i].dev == st->st_dev
+		    && (!match_mtime
+			|| (files[i].mtime.tv_sec == st->st_mtim.tv_sec
+			    && files[i].mtime.tv_nsec == st->st_mtim.tv_nsec))) {
+			return 1;
 		}
 	}
-	dprintf(error_fd, "Failed to add new source. Already at limit.\n");
-	return 1;
+	return 0;
 }
 
-int
-exec_sources()
+static void
+add_sourced(struct sourced_file **files, size_t *n, size_t *size,
+	    const char *path, const struct stat *st)
 {
-	int index;
+	struct sourced_file *new_files;
 
-	for (index = 0; index < MAX_SOURCE_FILES; index++) {
-		if (sources[index] == NULL) {
-			break;
+	if (*n == *size) {
+		*size = *size == 0 ? SOURCED_INITIAL_SIZE : *size * 2;
+		new_files = realloc(*files, *size * sizeof(struct sourced_file));
+		if (new_files == NULL) {
+			err(EXIT_FAILURE, "malloc failed");
 		}
-		read_source_file(sources[index]->file);
+		*files = new_files;
 	}
-	return 0;
+	(*files)[*n].path = NULL;
+	if (path != NULL && ((*files)[*n].path = strdup(path)) == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	(*files)[*n].dev = st->st_dev;
+	(*files)[*n].ino = st->st_ino;
+	(*files)[*n].mtime = st->st_mtim;
+	(*n)++;
 }
 
+// Regular files are mapped, or their compiled script when there is a cache,
+// and anything else is read at once, so no fd is left open while the
+// commands run and fork
 int
 read_source_file(char *filename)
 {
-	char *buf = malloc(MAX_ARGUMENT_SIZE);
-
-	if (buf == NULL)
-		err(EXIT_FAILURE, "malloc failed");
-	memset(buf, 0, MAX_ARGUMENT_SIZE);
-	FILE *f = fopen(filename, "r");
-
-	while (fgets(buf, MAX_ARGUMENT_SIZE, f) != NULL) {	/* break with ^D or ^Z */
-		if (find_command(buf, NULL, f, NULL, NULL) == -1) {
-			fclose(f);
-			free(buf);
+	struct script script;
+	struct stat st;
+	CompiledScript compiled;
+	Buffer *file_buffer = NULL;
+	void *map = NULL;
+	char *buf;
+	int status;
+	int fd = open_shell_file(filename);
+
+	if (fd < 0) {
+		return 0;
+	}
+	script.compiled = 0;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+		if (script_cache_dir != NULL
+		    && load_compiled_script(&compiled, &st)) {
+			close(fd);
+			script.compiled = 1;
+		} else {
+			map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+				   fd, 0);
+			close(fd);
+			if (map == MAP_FAILED) {
+				return 0;
+			}
+			madvise(map, st.st_size, MADV_SEQUENTIAL);
+			if (script_cache_dir != NULL) {
+				compile_script(&compiled, &st, map,
+					       st.st_size);
+				munmap(map, st.st_size);
+				map = NULL;
+				script.compiled = 1;
+			}
+		}
+	} else {
+		file_buffer = new_buffer();
+		if (read_to_buffer(file_buffer, fd) < 0) {
+			close(fd);
+			free_buffer(file_buffer);
 			return 0;
 		}
+		close(fd);
+	}
+	if (script.compiled) {
+		script.data = compiled.lines;
+		script.size = compiled.end - compiled.lines;
+	} else if (map != NULL) {
+		script.data = map;
+		script.size = st.st_size;
+	} else {
+		script.data = file_buffer->data;
+		script.size = file_buffer->len;
+	}
+	script.pos = 0;
+	script.prev = current_script;
+	current_script = &script;
+
+	buf = malloc(MAX_ARGUMENT_SIZE);
+	if (buf == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
 	}
-	if (ferror(f)) {
-		err(EXIT_FAILURE, "fgets failed");
+	for (status = 1; status > 0 && !has_to_exit;) {
+		if (script.compiled) {
+			status = run_compiled_line(&script, buf);
+		} else if (read_script_line(buf, MAX_ARGUMENT_SIZE) == NULL) {
+			status = 0;
+		} else if (find_command(buf, NULL, stdin, NULL, NULL) == -1) {
+			status = -1;
+		}
 	}
-	fclose(f);
+	current_script = script.prev;
 	free(buf);
+	if (script.compiled) {
+		free_compiled_script(&compiled);
+	} else if (map != NULL) {
+		munmap(map, script.size);
+	} else {
+		free_buffer(file_buffer);
+	}
 	return 1;
 }
 
-int
-find_path_srcfile(char *filename)
+// Returns 1 if a line was run | 0 at the end | -1 if find_command failed
+static int
+run_compiled_line(struct script *script, char *buf)
 {
-	int i;
-	char *cwd;
-	char *cwd_ptr;
-
-	char *path, *orig_path;
-	char *path_ptr;
-	int path_len = 0;
-	char path_tok[MAX_PATH_LOCATIONS][MAX_ENV_SIZE];
-	char *token;
+	ScriptLine line;
+	const char *ptr = script->data + script->pos;
 
-	// Check if the first character is /
-	if (*filename == '/' && file_exists(filename)) {
+	if (!next_script_line(&ptr, script->data + script->size, &line)) {
+		return 0;
+	}
+	script->pos = ptr - script->data;
+	switch (line.kind) {
+	case SCRIPT_BLANK:
+		// Like an empty command
+		last_status = 0;
 		return 1;
+	case SCRIPT_COMMENT:
+		if (syntax_mode != BASIC_SYNTAX) {
+			last_status = 0;
+			return 1;
+		}
+		break;
+	case SCRIPT_WORDS:
+		// An alias may have been defined after the script was compiled
+		if (find_alias(line.words[0]) == NULL) {
+			exec_words(buf, line.words, line.n_words, stdin);
+			return 1;
+		}
+		break;
 	}
-	// CHECK IN CWD
-	cwd = malloc(MAX_ENV_SIZE);
+	memcpy(buf, line.text, line.len + 1);
+	return find_command(buf, NULL, stdin, NULL, NULL) == -1 ? -1 : 1;
+}
 
-	if (cwd == NULL) {
-		err(EXIT_FAILURE, "malloc failed");
+char *
+read_script_line(char *line, int size)
+{
+	struct script *script = current_script;
+	const char *start, *eol;
+	ScriptLine compiled_line;
+	size_t len;
+
+	if (script == NULL) {
+		return fgets(line, size, stdin);
 	}
-	memset(cwd, 0, MAX_ENV_SIZE);
-	// Copy the path
-	if (getcwd(cwd, MAX_ENV_SIZE) == NULL) {
-		free(cwd);
-		return 0;
+	if (script->pos >= script->size) {
+		return NULL;
 	}
-	cwd_ptr = cwd;
+	start = script->data + script->pos;
+	if (script->compiled) {
+		eol = start;
+		if (!next_script_line(&eol, script->data + script->size,
+				      &compiled_line)) {
+			return NULL;
+		}
+		script->pos = eol - script->data;
+		len = compiled_line.len;
+		if (len > (size_t)size - 1) {
+			len = size - 1;
+		}
+		memcpy(line, compiled_line.text, len);
+		line[len] = '\0';
+		return line;
+	}
+	len = script->size - script->pos;
+	eol = memchr(start, '\n', len);
+	if (eol != NULL) {
+		len = eol - start + 1;
+	}
+	if (len > (size_t)size - 1) {
+		len = size - 1;
+	}
+	memcpy(line, start, len);
+	line[len] = '\0';
+	script->pos += len;
+	return line;
+}
 
-	strcat(cwd_ptr, "/");
-	strcat(cwd_ptr, filename);
+// Returns the path of the file in the cwd or in PATH, NULL if not found
+char *
+find_path_srcfile(const char *filename)
+{
+	char *path, *path_ptr;
+	char *token;
+	char *found;
 
-	if (file_exists(cwd_ptr)) {
-		strcpy(filename, cwd_ptr);
-		free(cwd);
-		return 1;
+	if (*filename == '/' || file_exists(filename)) {
+		if (!file_exists(filename)) {
+			return NULL;
+		}
+		found = strdup(filename);
+		if (found == NULL) {
+			err(EXIT_FAILURE, "malloc failed");
+		}
+		return found;
 	}
-	free(cwd);
-
-	// SEARCH IN PATH
-	// First get the path from env PATH
-	path = malloc(MAX_PATH_SIZE);
 
+	path = get_var("PATH");
 	if (path == NULL) {
-		err(EXIT_FAILURE, "malloc failed");
+		return NULL;
 	}
-	memset(path, 0, MAX_PATH_SIZE);
-	// Copy the path
-	orig_path = getenv("PATH");
-	if (orig_path == NULL || strlen(orig_path) > MAX_PATH_SIZE - 1) {
-		free(path);
-		return 0;
+	path = strdup(path);
+	if (path == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
 	}
-	strcpy(path, orig_path);
-	path_ptr = path;
-
 	// Then separate the path by : using strtok
-	while ((token = strtok_r(path_ptr, ":", &path_ptr))) {
-		strcpy(path_tok[path_len], token);
-		path_len++;
-	}
-	// Loop through the path until we find an exec
-
-	for (i = 0; i < path_len; i++) {
-		strcat(path_tok[i], "/");
-		strcat(path_tok[i], filename);
-		if (file_exists(path_tok[i])) {
-			strcpy(filename, path_tok[i]);
+	for (path_ptr = path; (token = strtok_r(path_ptr, ":", &path_ptr));) {
+		found = malloc(strlen(token) + strlen(filename) + 2);
+		if (found == NULL) {
+			err(EXIT_FAILURE, "malloc failed");
+		}
+		sprintf(found, "%s/%s", token, filename);
+		if (file_exists(found)) {
 			free(path);
-			return 1;
+			return found;
 		}
+		free(found);
 	}
 	free(path);
-	return 0;
+	return NULL;
 }
 
 int
-file_exists(char *path)
+file_exists(const char *path)
 {
 	struct stat buf;
 
@@ -23,13 +23,16 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include "variables.h"
 #include "open_files.h"
+#include "buffer.h"
 #include "builtin/command.h"
 #include "builtin/builtin.h"
 #include "builtin/export.h"
 #include "builtin/source.h"
 #include "builtin/alias.h"
 #include "builtin/exit.h"
+#include "builtin/exec.h"
 #include "parse.h"
 #include "exec_info.h"
 #include "parse_line.h"
@@ -63,8 +66,11 @@ find_path(Command * command)
 		err(EXIT_FAILURE, "malloc failed");
 	}
 	memset(cwd, 0, MAX_ENV_SIZE);
-	// Copy the path
-	if (getcwd(cwd, MAX_ENV_SIZE) == NULL) {
+	// Copy the path, cd keeps PWD up to date
+	cwd_ptr = get_var("PWD");
+	if (cwd_ptr != NULL && strlen(cwd_ptr) < MAX_ENV_SIZE - 1) {
+		strcpy(cwd, cwd_ptr);
+	} else if (getcwd(cwd, MAX_ENV_SIZE) == NULL) {
 		free(cwd);
 		return -1;
 	}
@@ -89,7 +95,7 @@ find_path(Command * command)
 	}
 	memset(path, 0, MAX_PATH_SIZE);
 	// Copy the path
-	orig_path = getenv("PATH");
+	orig_path = get_var("PATH");
 	if (orig_path == NULL || strlen(orig_path) > MAX_PATH_SIZE - 1) {
 		free(path);
 		return -1;
@@ -141,7 +147,7 @@ exec_cmd(Command * cmd, Command * start_cmd, Command * last_cmd)
 	close_all_fd_cmd(cmd, start_cmd);
 	redirect_stdin(cmd, start_cmd);
 	redirect_stdout(cmd);
-	redirect_stderr(cmd);
+	redirect_fds(cmd);
 	// Check if builtin
 	if (cmd->search_location != SEARCH_CMD_ONLY_COMMAND
 	    && find_builtin(cmd)) {
@@ -179,7 +185,7 @@ exec_cmd(Command * cmd, Command * start_cmd, Command * last_cmd)
 		}
 
 		args[i] = NULL;
-		execv(args[0], args);
+		execve(args[0], args, start_cmd->envp);
 	}
 }
 
@@ -201,7 +207,9 @@ read_from_here_doc(Command * start_command)
 	char *here_doc_buffer = new_here_doc_buffer();
 
 	do {
-		fgets(buffer_stdin, MAX_BUFFER_IO_SIZE, stdin);
+		if (read_script_line(buffer_stdin, MAX_BUFFER_IO_SIZE) == NULL) {
+			break;
+		}
 		if (strlen(buffer_stdin) >= MAX_BUFFER_IO_SIZE - 1) {
 			has_max_length = 1;
 		} else {
@@ -236,25 +244,10 @@ read_from_here_doc(Command * start_command)
 void
 write_to_buffer(Command * last_command)
 {
-	ssize_t count = MAX_BUFFER_IO_SIZE;
-	ssize_t bytes_stdout;
-
-	// Create stdout buffer
-	char *buffer_stdout = malloc(sizeof(char[MAX_BUFFER_IO_SIZE]));
-
-	if (buffer_stdout == NULL) {
-		err(EXIT_FAILURE, "malloc failed");
+	if (read_to_buffer(last_command->output_buffer,
+			   last_command->fd_pipe_output[0]) < 0) {
+		fprintf(stderr, "Mash: error: failed to read command output\n");
 	}
-	memset(buffer_stdout, 0, MAX_BUFFER_IO_SIZE);
-
-	do {
-		bytes_stdout =
-		    read(last_command->fd_pipe_output[0], buffer_stdout, count);
-		if (bytes_stdout > 0) {
-			strcat(last_command->output_buffer, buffer_stdout);
-		}
-	} while (bytes_stdout > 0);
-	free(buffer_stdout);
 	close_fd(last_command->fd_pipe_output[0]);
 }
 
@@ -262,7 +255,7 @@ write_to_buffer(Command * last_command)
 void
 redirect_stdin(Command * command, Command * start_command)
 {
-// NOT INPUT COMMAND OR INPUT COMMAND WITH FILE
+// NOT INPUT COMMAND OR INPUT COMMAND WITH HERE DOCUMENT
 	if (command->pid != start_command->pid
 	    || start_command->input == HERE_DOC_FILENO) {
 		if (dup2(command->fd_pipe_input[0], STDIN_FILENO) == -1) {
@@ -271,44 +264,92 @@ redirect_stdin(Command * command, Command * start_command)
 		}
 		close_fd(command->fd_pipe_input[0]);
 	}
-	if (command->input != STDIN_FILENO && command->input != HERE_DOC_FILENO) {
-		if (dup2(command->input, STDIN_FILENO) == -1) {
-			err(EXIT_FAILURE, "Failed to dup stdin b%i",
-			    command->input);
-		}
-		close_fd(command->input);
-	}
 }
 
 void
 redirect_stdout(Command * command)
 {
-	// NOT LAST COMMAND OR LAST COMMAND WITH FILE OR BUFFER
+	// NOT LAST COMMAND OR LAST COMMAND WITH BUFFER
 	if (command->pipe_next || command->output_buffer) {
 		// redirect stdout
 		if (dup2(command->fd_pipe_output[1], STDOUT_FILENO) == -1) {
 			err(EXIT_FAILURE, "Failed to dup stdout");
 		}
 	}
-
-	if (command->output != STDOUT_FILENO) {
-		if (dup2(command->output, STDOUT_FILENO) == -1) {
-			err(EXIT_FAILURE, "Failed to dup stdout");
-		}
-		if (command->output != command->err_output) {
-			close_fd(command->output);
-		}
-	}
 }
 
 void
-redirect_stderr(Command * command)
+redirect_fds(Command * command)
 {
+	int source[MAX_REDIRECTIONS + 3];
+	int target[MAX_REDIRECTIONS + 3];
+	int n_fds = 0;
+	int i;
+	int j;
+	int moved;
+	Redirection *redirection;
+
+	// Duplicates of std fds come before their files replace them
+	for (i = 0; i < command->n_redirections; i++) {
+		redirection = &command->redirections[i];
+		if (redirection->type == REDIRECT_DUP) {
+			source[n_fds] = redirection->source;
+			target[n_fds++] = redirection->fd;
+		}
+	}
+	if (command->input > 0) {
+		source[n_fds] = command->input;
+		target[n_fds++] = STDIN_FILENO;
+	}
+	if (command->output != STDOUT_FILENO) {
+		source[n_fds] = command->output;
+		target[n_fds++] = STDOUT_FILENO;
+	}
 	if (command->err_output != STDERR_FILENO) {
-		if (dup2(command->err_output, STDERR_FILENO) == -1) {
-			err(EXIT_FAILURE, "Failed to dup stdout");
+		source[n_fds] = command->err_output;
+		target[n_fds++] = STDERR_FILENO;
+	}
+	for (i = 0; i < command->n_redirections; i++) {
+		redirection = &command->redirections[i];
+		if (redirection->type == REDIRECT_FILE) {
+			source[n_fds] = redirection->source;
+			target[n_fds++] = redirection->fd;
+		} else if (redirection->type == REDIRECT_CLOSE) {
+			source[n_fds] = -1;
+			target[n_fds++] = redirection->fd;
+		}
+	}
+
+	for (i = 0; i < n_fds; i++) {
+		// Move away a source this would overwrite before it is used
+		moved = -1;
+		for (j = i + 1; j < n_fds; j++) {
+			if (source[j] != target[i] || source[i] == target[i]) {
+				continue;
+			}
+			if (moved < 0) {
+				moved = fcntl(target[i], F_DUPFD_CLOEXEC,
+					      MAX_SHELL_FDS);
+			}
+			source[j] = moved;
+		}
+		if (source[i] < 0) {
+			close(target[i]);
+		} else if (source[i] == target[i]) {
+			fcntl(target[i], F_SETFD, 0);
+		} else if (dup2(source[i], target[i]) == -1) {
+			err(EXIT_FAILURE, "Failed to redirect fd %d", target[i]);
+		}
+	}
+	// Every source is now in its target
+	for (i = 0; i < n_fds; i++) {
+		if (source[i] <= STDERR_FILENO) {
+			continue;
+		}
+		for (j = 0; j < n_fds && target[j] != source[i]; j++) ;
+		if (j == n_fds) {
+			close_fd(source[i]);
 		}
-		close_fd(command->err_output);
 	}
 }
 
@@ -354,7 +395,8 @@ set_output_shell_pipe(Command * start_command)
 int
 close_fd(int fd)
 {
-	if (fd >= 0) {
+	// Fds opened with exec stay open until exec closes them
+	if (fd >= 0 && !is_shell_fd(fd)) {
 		close(fd);
 		return 0;
 	}
@@ -365,6 +407,7 @@ int
 close_all_fd(Command * start_command)
 {
 	Command *command = start_command;
+	int i;
 
 	while (command != NULL) {
 		if (command->input != STDIN_FILENO) {
@@ -376,6 +419,11 @@ close_all_fd(Command * start_command)
 		if (command->err_output != STDERR_FILENO) {
 			close_fd(command->err_output);
 		}
+		for (i = 0; i < command->n_extra_outputs; i++) {
+			close_fd(command->extra_output[i]);
+		}
+		command->n_extra_outputs = 0;
+		close_redirections(command);
 		close_fd(command->fd_pipe_input[0]);
 		close_fd(command->fd_pipe_input[1]);
 		close_fd(command->fd_pipe_output[0]);
@@ -427,6 +475,7 @@ close_all_fd_io(Command * start_command, Command * last_command)
 		if (command->err_output != STDERR_FILENO) {
 			close_fd(command->err_output);
 		}
+		close_redirections(command);
 		command = command->pipe_next;
 	}
 
@@ -454,6 +503,7 @@ close_all_fd_cmd(Command * command, Command * start_command)
 			if (new_cmd->output != STDOUT_FILENO) {
 				close_fd(new_cmd->output);
 			}
+			close_redirections(new_cmd);
 			// Close if the cmd output is not the next input
 			if (new_cmd->fd_pipe_input[1] !=
 			    command->fd_pipe_output[1]) {
@@ -471,3 +521,17 @@ close_all_fd_cmd(Command * command, Command * start_command)
 	}
 	return 1;
 }
+
+int
+close_redirections(Command * command)
+{
+	int i;
+
+	for (i = 0; i < command->n_redirections; i++) {
+		if (command->redirections[i].type == REDIRECT_FILE) {
+			close_fd(command->redirections[i].source);
+		}
+	}
+	command->n_redirections = 0;
+	return 1;
+}
@@ -43,7 +43,6 @@ new_sub_info()
 void
 restore_sub_info(SubInfo * sub_info)
 {
-	//memset(sub_info->last_alias, 0, MAX_ARGUMENT_SIZE);
 	memset(sub_info->buffer, 0, MAX_ENV_SIZE);
 	sub_info->old_ptr = NULL;
 	sub_info->old_lexer = NULL;
@@ -17,6 +17,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <err.h>
 #include <errno.h>
@@ -24,6 +25,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "open_files.h"
+#include "variables.h"
 #include "builtin/command.h"
 #include "builtin/builtin.h"
 #include "builtin/export.h"
@@ -35,6 +37,7 @@
 #include "parse_line.h"
 #include "mash.h"
 #include "exec_cmd.h"
+#include "multio.h"
 #include "exec_pipe.h"
 
 int
@@ -56,11 +59,22 @@ launch_pipe(FILE * src_file, ExecInfo * exec_info, char *to_free_excess)
 	if (cmd->search_location != SEARCH_CMD_ONLY_COMMAND &&
 	    cmd->do_wait != DO_NOT_WAIT_TO_FINISH &&
 	    has_builtin_exec_in_shell(cmd)) {
+		prepare_multio(cmd);
+		start_multio(cmd);
+		int exit_code = exec_builtin_in_shell(cmd, 0);
+
+		end_multio(cmd, 1);
+		// Input is only closed once builtins like mapfile read it
 		close_all_fd_no_fork(cmd);
-		return exec_builtin_in_shell(cmd, 0);
+		return exit_code;
 	}
 
-	return exec_pipe(src_file, exec_info, to_free_excess);;
+	if (has_builtin_exec_in_buffer(cmd)) {
+		close_all_fd_no_fork(cmd);
+		return exec_builtin_in_buffer(cmd);
+	}
+
+	return exec_pipe(src_file, exec_info, to_free_excess);
 }
 
 int
@@ -78,6 +92,8 @@ exec_pipe(FILE * src_file, ExecInfo * exec_info, char *to_free_excess)
 	    || set_output_shell_pipe(exec_info->command)) {
 		return 1;
 	}
+	prepare_multio(exec_info->command);
+	exec_info->command->envp = get_envp();
 	// Make a loop fork each command
 	for (current_command = exec_info->command; current_command;
 	     current_command = current_command->pipe_next) {
@@ -93,6 +109,7 @@ exec_pipe(FILE * src_file, ExecInfo * exec_info, char *to_free_excess)
 	switch (current_command->pid) {
 	case -1:
 		close_all_fd(exec_info->command);
+		end_multio(exec_info->command, 0);
 		fprintf(stderr, "Mash: Failed to fork");
 		return EXIT_FAILURE;
 		break;
@@ -117,7 +134,9 @@ exec_pipe(FILE * src_file, ExecInfo * exec_info, char *to_free_excess)
 	default:
 		close(null);
 		close_all_fd_io(exec_info->command, current_command);
+		start_multio(exec_info->command);
 		if (current_command->do_wait == DO_NOT_WAIT_TO_FINISH) {
+			end_multio(exec_info->command, 0);
 			return EXIT_SUCCESS;
 		}
 
@@ -125,7 +144,10 @@ exec_pipe(FILE * src_file, ExecInfo * exec_info, char *to_free_excess)
 			read_from_here_doc(exec_info->command);
 		}
 
-		return wait_pipe(current_command->pid);
+		int exit_code = wait_pipe(current_command->pid);
+
+		end_multio(exec_info->command, 1);
+		return exit_code;
 		break;
 	}
 	return EXIT_FAILURE;
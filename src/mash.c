@@ -13,7 +13,11 @@
 // limitations under the License.
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include <time.h>
+#include <errno.h>
+#include <stdint.h>
 #include <signal.h>
 #include <pwd.h>
 #include <stdlib.h>
@@ -21,6 +25,7 @@
 #include <stdio.h>
 #include <err.h>
 #include <string.h>
+#include "variables.h"
 #include "builtin/command.h"
 #include "builtin/export.h"
 #include "builtin/alias.h"
@@ -33,16 +38,35 @@
 #include "exec_cmd.h"
 #include "mash.h"
 #include "builtin/jobs.h"
+#include "snapshot.h"
+#include "buffer.h"
+#include "script_cache.h"
 
+extern char **environ;
 int reading_from_file = 0;
 int writing_to_file = 0;
 char flags[3];
 char version[32] = "1.0.0";
+int last_status = 0;
+
+// File given as argument, it is run instead of reading stdin
+static char *script_file = NULL;
+static int startup_profile = 0;
+static struct timespec phase_start;
+static double startup_total = 0;
+static int use_script_cache = 1;
+static int clear_cache = 0;
+
+static void profile_phase(const char *phase);
+static int run_script();
+static int init_script_cache();
 
 static void
 usage()
 {
-	fprintf(stderr, "Usage: mash [-ibej]\n");
+	fprintf(stderr,
+		"Usage: mash [-ibejp] [--startup-profile] [--no-script-cache]\n"
+		"            [--clear-script-cache] [file]\n");
 	exit(EXIT_FAILURE);
 }
 
@@ -50,9 +74,19 @@ static void
 help()
 {
 	printf("Mash, version %s\n", version);
-	printf("Usage: mash [-ibe]\n\n");
+	printf("Usage: mash [-ibep] [--startup-profile] [--no-script-cache]\n");
+	printf("            [--clear-script-cache] [file]\n\n");
 	printf("Options:\n\t-i\tInteractive mode\n");
-	printf("\t-b\tBasic syntax\n\t-e\tExtended syntax\n\n");
+	printf("\t-b\tBasic syntax\n\t-e\tExtended syntax\n");
+	printf("\t-p\tRun the command substitutions of a command concurrently\n");
+	printf("\t--startup-profile\tPrint how long each phase of the startup took\n");
+	printf("\t--no-script-cache\tDo not use the compiled scripts of MASH_SCRIPT_CACHE\n");
+	printf("\t--clear-script-cache\tRemove the compiled scripts of MASH_SCRIPT_CACHE\n\n");
+	printf("Without -i, a FILE is run as a script without reading env/.mashrc\n\n");
+	printf("Environment:\n\tMASH_SNAPSHOT\tFile to save the aliases and variables set by\n");
+	printf("\t\t\tenv/.mashrc and to load them from while it is unchanged\n");
+	printf("\tMASH_SCRIPT_CACHE\tDirectory to save the sourced files and scripts\n");
+	printf("\t\t\tcompiled, they are used while the file is unchanged\n\n");
 	printf
 	    ("Enter mash and type `help' for more information about shell builtin commands.\n\n");
 	printf("Mash source code: <https://github.com/javizqh/Mash>\n");
@@ -71,9 +105,21 @@ main(int argc, char *argv[])
 		help();
 	}
 
+	clock_gettime(CLOCK_MONOTONIC, &phase_start);
 	set_arguments(argv);
+	if (!init_script_cache()) {
+		return EXIT_FAILURE;
+	}
+	if (clear_cache) {
+		return EXIT_SUCCESS;
+	}
+	profile_phase("arguments");
 	init_mash();
 
+	if (script_file != NULL) {
+		return run_script();
+	}
+
 	// ---------- Read command line
 	// ------ Buffer
 	char *buf = malloc(MAX_ARGUMENT_SIZE);
@@ -124,13 +170,90 @@ set_flag_string()
 	return;
 }
 
+// Prints the time since the last phase ended
+static void
+profile_phase(const char *phase)
+{
+	struct timespec now;
+	double elapsed;
+
+	if (!startup_profile) {
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	elapsed = (now.tv_sec - phase_start.tv_sec) * 1e6
+	    + (now.tv_nsec - phase_start.tv_nsec) / 1e3;
+	startup_total += elapsed;
+	fprintf(stderr, "mash: startup: %-10s %9.1f us\n", phase, elapsed);
+	if (strcmp(phase, "cwd") == 0) {
+		fprintf(stderr, "mash: startup: %-10s %9.1f us\n", "total",
+			startup_total);
+	}
+	// Printing is not part of the next phase
+	clock_gettime(CLOCK_MONOTONIC, &phase_start);
+}
+
+static int
+run_script()
+{
+	int status;
+
+	if (!read_source_file(script_file)) {
+		fprintf(stderr, "mash: %s: %s\n", script_file, strerror(errno));
+		status = 127;
+	} else {
+		status = last_status;
+	}
+	if (!has_to_exit) {
+		exit_mash(0, NULL, STDOUT_FILENO, STDERR_FILENO);
+	}
+	return status;
+}
+
+// Returns 0 if the cache could not be cleared
+static int
+init_script_cache()
+{
+	char *dir = getenv("MASH_SCRIPT_CACHE");
+
+	if (dir == NULL || *dir == '\0') {
+		if (clear_cache) {
+			fprintf(stderr, "Mash: MASH_SCRIPT_CACHE is not set\n");
+			return 0;
+		}
+		return 1;
+	}
+	script_cache_dir = strdup(dir);
+	if (script_cache_dir == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	if (clear_cache && clear_script_cache() < 0) {
+		fprintf(stderr, "Mash: could not clear %s: %s\n",
+			script_cache_dir, strerror(errno));
+		return 0;
+	}
+	if (!use_script_cache || clear_cache) {
+		free(script_cache_dir);
+		script_cache_dir = NULL;
+	}
+	return 1;
+}
+
 int
 set_arguments(char *argv[])
 {
 	char *arg_ptr;
 
 	for (; *argv != NULL; argv++) {
-		if (*argv[0] == '-') {
+		if (strcmp(*argv, "--startup-profile") == 0) {
+			startup_profile = 1;
+		} else if (strcmp(*argv, "--no-script-cache") == 0) {
+			use_script_cache = 0;
+		} else if (strcmp(*argv, "--clear-script-cache") == 0) {
+			clear_cache = 1;
+		} else if (script_file != NULL) {
+			usage();
+		} else if (*argv[0] == '-') {
 			arg_ptr = argv[0];
 			arg_ptr++;
 			for (; *arg_ptr != '\0'; arg_ptr++) {
@@ -146,54 +269,111 @@ set_arguments(char *argv[])
 					syntax_mode = EXTENDED_SYNTAX;
 					use_job_control = 1;
 					break;
+				case 'p':
+					concurrent_subexec = 1;
+					break;
 				default:
 					usage();
 					break;
 				}
 			}
 		} else {
-			usage();
+			script_file = *argv;
 		}
 	}
 	set_flag_string();
 	return 1;
 }
 
+// With MASH_SNAPSHOT set, the aliases and variables left by .mashrc are
+// saved in that file and loaded from it while no sourced file changes
+static void
+run_rc()
+{
+	char *snapshot = get_var("MASH_SNAPSHOT");
+
+	if (snapshot != NULL && *snapshot != '\0') {
+		snapshot = strdup(snapshot);
+		if (snapshot == NULL) {
+			err(EXIT_FAILURE, "malloc failed");
+		}
+	} else {
+		snapshot = NULL;
+	}
+
+	if (snapshot != NULL && load_snapshot(snapshot)) {
+		free(snapshot);
+		return;
+	}
+	if (file_exists("env/.mashrc")) {
+		// The snapshot only depends on the environment the rc uses
+		track_environment(snapshot != NULL);
+		exec_source("env/.mashrc", 0, STDERR_FILENO);
+		track_environment(0);
+		if (snapshot != NULL && save_snapshot(snapshot) < 0) {
+			fprintf(stderr, "Mash: could not save snapshot %s\n",
+				snapshot);
+		}
+	}
+	free(snapshot);
+}
+
 int
 init_mash()
 {
 	char cwd[MAX_ENV_SIZE];
+	struct passwd *pw;
+	// Scripts skip what only an interactive shell needs
+	int is_script = script_file != NULL && shell_mode != INTERACTIVE_MODE;
 
-	if (!isatty(0)) {
-		reading_from_file = 1;
-	}
+	init_variables(environ);
+	profile_phase("variables");
+
+	// Commands of a script keep the stdin of mash, it is not the script
+	if (!is_script) {
+		if (!isatty(0)) {
+			reading_from_file = 1;
+		}
 
-	if (!isatty(1)) {
-		writing_to_file = 1;
+		if (!isatty(1)) {
+			writing_to_file = 1;
+		}
 	}
+	profile_phase("tty");
 
 	if (syntax_mode == BASIC_SYNTAX) {
 		load_basic_lex_tables();
+		profile_phase("lexer");
 	} else {
-		signal(SIGINT, sig_handler);
-		signal(SIGTSTP, sig_handler);
+		if (!is_script) {
+			signal(SIGINT, sig_handler);
+			signal(SIGTSTP, sig_handler);
+		}
 		load_lex_tables();
-		add_source("env/.mashrc", STDERR_FILENO);
-		exec_sources();
+		profile_phase("lexer");
+		if (!is_script) {
+			run_rc();
+		}
+		profile_phase("rc");
 	}
 
 	if (use_job_control) {
 		init_jobs_list();
 	}
+	profile_phase("jobs");
 
-	add_env_by_name("HOME", getpwuid(getuid())->pw_dir);
+	// Like other shells, a HOME from the environment is kept
+	if (get_var("HOME") == NULL && (pw = getpwuid(getuid())) != NULL) {
+		add_env_by_name("HOME", pw->pw_dir);
+	}
+	profile_phase("home");
 
 	if (getcwd(cwd, MAX_ENV_SIZE) == NULL) {
 		exit_mash(0, NULL, STDOUT_FILENO, STDERR_FILENO);
 		err(EXIT_FAILURE, "error getting current working directory");
 	}
 	add_env_by_name("PWD", cwd);
-	add_env_by_name("result", "0");
+	profile_phase("cwd");
 
 	return 1;
 }
@@ -0,0 +1,285 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#define _GNU_SOURCE
+#include <sys/types.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <err.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "builtin/command.h"
+#include "exec_cmd.h"
+#include "multio.h"
+
+// DECLARE STATIC FUNCTIONS
+static int needs_multio(Command * command);
+static Multio *new_multio(Command * command);
+static void free_multio(Multio * multio);
+static void release_multio(Multio * multio);
+static int add_multio_output(Multio * multio, int fd);
+static void *multio_thread(void *arg);
+static int move_to_output(Multio * multio, int from, int i, size_t len);
+
+int
+needs_multio(Command * command)
+{
+	int n_outputs = command->n_extra_outputs;
+
+	if (command->output != STDOUT_FILENO) {
+		n_outputs++;
+	}
+	// Only fan out to the next command if also writing to a file
+	if (n_outputs > 0 && command->pipe_next != NULL) {
+		n_outputs++;
+	}
+	return n_outputs > 1;
+}
+
+Multio *
+new_multio(Command * command)
+{
+	int i;
+	int fd[2];
+	Multio *multio = (Multio *) malloc(sizeof(Multio));
+
+	// Check if malloc failed
+	if (multio == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	memset(multio, 0, sizeof(Multio));
+	multio->n_outputs = 0;
+	multio->has_thread = 0;
+	multio->refs = 1;
+
+	if (pipe2(fd, O_CLOEXEC) < 0) {
+		// Keep only the first output
+		for (i = 0; i < command->n_extra_outputs; i++) {
+			close_fd(command->extra_output[i]);
+		}
+		command->n_extra_outputs = 0;
+		free(multio);
+		return NULL;
+	}
+	multio->input = fd[0];
+
+	// The multio owns its outputs, no other process has to keep them
+	if (command->output != STDOUT_FILENO) {
+		if (command->output == command->err_output) {
+			add_multio_output(multio,
+					  fcntl(command->output,
+						F_DUPFD_CLOEXEC, 0));
+		} else {
+			add_multio_output(multio, command->output);
+		}
+	}
+	for (i = 0; i < command->n_extra_outputs; i++) {
+		add_multio_output(multio, command->extra_output[i]);
+	}
+	command->n_extra_outputs = 0;
+	if (command->pipe_next != NULL) {
+		add_multio_output(multio,
+				  fcntl(command->fd_pipe_output[1],
+					F_DUPFD_CLOEXEC, 0));
+	}
+
+	command->output = fd[1];
+	return multio;
+}
+
+void
+free_multio(Multio * multio)
+{
+	int i;
+
+	close_fd(multio->input);
+	for (i = 0; i < multio->n_outputs; i++) {
+		close_fd(multio->outputs[i]);
+	}
+	free(multio);
+}
+
+int
+add_multio_output(Multio * multio, int fd)
+{
+	if (fd < 0 || multio->n_outputs >= MAX_MULTIO_OUTPUTS) {
+		close_fd(fd);
+		return -1;
+	}
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+	multio->outputs[multio->n_outputs++] = fd;
+	return 0;
+}
+
+void
+prepare_multio(Command * start_command)
+{
+	Command *command;
+
+	for (command = start_command; command; command = command->pipe_next) {
+		if (!needs_multio(command)) {
+			continue;
+		}
+		command->multio = new_multio(command);
+		if (command->multio == NULL) {
+			fprintf(stderr, "Mash: failed to pipe multiple outputs\n");
+		}
+	}
+}
+
+void
+start_multio(Command * start_command)
+{
+	Command *command;
+	Multio *multio;
+
+	for (command = start_command; command; command = command->pipe_next) {
+		multio = command->multio;
+		if (multio == NULL) {
+			continue;
+		}
+		// Shared by this thread and the multio thread
+		multio->refs = 2;
+		if (pthread_create(&multio->thread, NULL, multio_thread, multio)
+		    != 0) {
+			fprintf(stderr, "Mash: failed to copy multiple outputs\n");
+			free_multio(multio);
+			command->multio = NULL;
+			continue;
+		}
+		multio->has_thread = 1;
+	}
+}
+
+void
+end_multio(Command * start_command, int join)
+{
+	Command *command;
+	Multio *multio;
+
+	for (command = start_command; command; command = command->pipe_next) {
+		multio = command->multio;
+		if (multio == NULL) {
+			continue;
+		}
+		command->multio = NULL;
+		if (!multio->has_thread) {
+			free_multio(multio);
+		} else if (join) {
+			pthread_join(multio->thread, NULL);
+			free_multio(multio);
+		} else {
+			pthread_detach(multio->thread);
+			release_multio(multio);
+		}
+	}
+}
+
+void
+release_multio(Multio * multio)
+{
+	if (__atomic_sub_fetch(&multio->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+		free_multio(multio);
+	}
+}
+
+void *
+multio_thread(void *arg)
+{
+	Multio *multio = (Multio *) arg;
+	sigset_t set;
+	int tmp[2];
+	ssize_t len;
+	int i;
+
+	// Closed readers must give EPIPE here, not kill the shell
+	sigemptyset(&set);
+	sigaddset(&set, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	if (pipe2(tmp, O_CLOEXEC) < 0) {
+		// tee() fails and the outputs are just closed
+		tmp[0] = tmp[1] = -1;
+	}
+	// tee() duplicates the input without consuming it, so every output
+	// but the last one gets a copy and the last one consumes the input
+	for (;;) {
+		len = tee(multio->input, tmp[1], MULTIO_CHUNK, 0);
+		if (len < 0 && errno == EINTR) {
+			continue;
+		}
+		if (len <= 0) {
+			break;
+		}
+		move_to_output(multio, tmp[0], 0, len);
+		for (i = 1; i < multio->n_outputs - 1; i++) {
+			// tmp is empty again so the same bytes fit
+			if (tee(multio->input, tmp[1], len, 0) != len) {
+				break;
+			}
+			move_to_output(multio, tmp[0], i, len);
+		}
+		move_to_output(multio, multio->input, multio->n_outputs - 1,
+			       len);
+	}
+	close_fd(tmp[0]);
+	close_fd(tmp[1]);
+	// Close now, even if nobody joins this thread
+	close_fd(multio->input);
+	for (i = 0; i < multio->n_outputs; i++) {
+		close_fd(multio->outputs[i]);
+	}
+	multio->input = -1;
+	multio->n_outputs = 0;
+	release_multio(multio);
+	return NULL;
+}
+
+int
+move_to_output(Multio * multio, int from, int i, size_t len)
+{
+	ssize_t moved;
+	char buffer[BUFSIZ];
+	int output = multio->outputs[i];
+
+	while (len > 0 && output >= 0) {
+		moved = splice(from, NULL, output, NULL, len, SPLICE_F_MOVE);
+		if (moved < 0 && errno == EINTR) {
+			continue;
+		}
+		if (moved <= 0) {
+			break;
+		}
+		len -= moved;
+	}
+	// Outputs splice can not write to are copied, closed ones discarded
+	while (len > 0) {
+		moved = read(from, buffer, len < BUFSIZ ? len : BUFSIZ);
+		if (moved <= 0) {
+			return -1;
+		}
+		len -= moved;
+		if (output >= 0 && write(output, buffer, moved) != moved) {
+			if (errno == EPIPE) {
+				close_fd(output);
+				multio->outputs[i] = output = -1;
+			}
+		}
+	}
+	return 0;
+}
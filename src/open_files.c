@@ -14,44 +14,101 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
 #include <err.h>
 #include "open_files.h"
 
+// Redirection files are opened once and never leak into executed commands
 int
 open_read_file(char *filename)
+{
+	return open_file(filename, O_RDONLY | O_CLOEXEC);
+}
+
+int
+open_write_file(char *filename)
+{
+	return open_file(filename, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC);
+}
+
+int
+open_append_file(char *filename)
+{
+	return open_file(filename, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC);
+}
+
+int
+open_read_write_file(char *filename)
+{
+	return open_file(filename, O_RDWR | O_CREAT | O_CLOEXEC);
+}
+
+int
+open_file(char *filename, int flags)
 {
 	int fd;
 
-	fd = open(filename, O_RDONLY);
+	fd = open(filename, flags, 0666);
 
 	// Check if error occurred
 	if (fd == -1) {
-		fprintf(stderr, "mash: %s: No such file or directory\n",
-			filename);
+		fprintf(stderr, "mash: %s: %s\n", filename, strerror(errno));
 	}
 	return fd;
 }
 
 int
-open_write_file(char *filename)
+open_shell_file(char *filename)
 {
 	int fd;
+	int shell_fd;
 
-	fd = open(filename, O_TRUNC | O_WRONLY);
-	// Check if error occurred, file not found
-	if (fd == -1) {
-		fd = open(filename, O_CREAT | O_WRONLY, 0777);
+	fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0 || fd >= MAX_SHELL_FDS) {
+		return fd;
 	}
-	// Check if error occurred again
-	if (fd == -1) {
-		err(EXIT_FAILURE, "open failed");
+	shell_fd = fcntl(fd, F_DUPFD_CLOEXEC, MAX_SHELL_FDS);
+	close(fd);
+	return shell_fd;
+}
+
+// Like every word, str is shorter than MAX_ARGUMENT_SIZE, so with its
+// newline it fits in an empty pipe and the write never blocks
+int
+open_here_string(char *str)
+{
+	int fd[2];
+	struct iovec here_string[2];
+	size_t len = strlen(str);
+
+	if (len + 1 > PIPE_BUF) {
+		fprintf(stderr, "mash: here string is too long\n");
+		return -1;
 	}
-	return fd;
+	here_string[0].iov_base = str;
+	here_string[0].iov_len = len;
+	here_string[1].iov_base = "\n";
+	here_string[1].iov_len = 1;
+
+	if (pipe(fd) < 0) {
+		fprintf(stderr, "mash: failed to create here string\n");
+		return -1;
+	}
+	if (writev(fd[1], here_string, 2) != (ssize_t) len + 1) {
+		fprintf(stderr, "mash: failed to write here string\n");
+		close(fd[0]);
+		close(fd[1]);
+		return -1;
+	}
+	close(fd[1]);
+	return fd[0];
 }
 
 char *
@@ -13,30 +13,42 @@
 // limitations under the License.
 
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <glob.h>
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <err.h>
+#include "variables.h"
 #include "builtin/command.h"
 #include "builtin/builtin.h"
 #include "builtin/export.h"
 #include "builtin/alias.h"
 #include "builtin/exit.h"
+#include "builtin/source.h"
 #include "open_files.h"
+#include "buffer.h"
+#include "pattern.h"
+#include "builtin/mash_math.h"
 #include "parse.h"
 #include "exec_info.h"
+#include "builtin/jobs.h"
 #include "parse_line.h"
 #include "show_prompt.h"
 #include "exec_cmd.h"
 #include "mash.h"
 
 int syntax_mode = EXTENDED_SYNTAX;
+int concurrent_subexec = 0;
 
 // DECLARE STATIC FUNCTIONS
 static char *copy(char *line, ExecInfo * exec_info);
 static char *copy_and_end_sub(char *line, ExecInfo * exec_info);
+static char *copy_or_end_sub(char *line, ExecInfo * exec_info);
 static char *do_glob(char *line, ExecInfo * exec_info);
 static char *start_squote(char *line, ExecInfo * exec_info);
 static char *end_squote(char *line, ExecInfo * exec_info);
@@ -46,14 +58,22 @@ static char *start_sub(char *line, ExecInfo * exec_info);
 static char *basic_start_sub(char *line, ExecInfo * exec_info);
 static char *tilde_tok(char *line, ExecInfo * exec_info);
 static char *end_sub(char *line, ExecInfo * exec_info);
+static char *brace_sub(char *line, ExecInfo * exec_info);
 static char *pipe_tok(char *line, ExecInfo * exec_info);
+static char *start_array(char *line, ExecInfo * exec_info);
+static char *end_array(char *line, ExecInfo * exec_info);
 static char *basic_pipe_tok(char *line, ExecInfo * exec_info);
+static char *start_in(char *line, ExecInfo * exec_info);
+static char *start_out(char *line, ExecInfo * exec_info);
+static char *start_here_string(char *line, ExecInfo * exec_info);
 static char *start_file_in(char *line, ExecInfo * exec_info);
 static char *basic_start_file_in(char *line, ExecInfo * exec_info);
 static char *start_file_out(char *line, ExecInfo * exec_info);
 static char *basic_start_file_out(char *line, ExecInfo * exec_info);
+static void take_fd_prefix(ExecInfo * exec_info);
 static char *here_doc(char *line, ExecInfo * exec_info);
 static char *end_file(char *line, ExecInfo * exec_info);
+static char *end_file_or_process_sub(char *line, ExecInfo * exec_info);
 static char *end_basic_file(char *line, ExecInfo * exec_info);
 static char *end_file_started(char *line, ExecInfo * exec_info);
 static char *end_basic_file_started(char *line, ExecInfo * exec_info);
@@ -63,6 +83,7 @@ static char *esp_escape(char *line, ExecInfo * exec_info);
 static char *background(char *line, ExecInfo * exec_info);
 static char *basic_background(char *line, ExecInfo * exec_info);
 static char *subexec(char *line, ExecInfo * exec_info);
+static char *process_sub(char *line, ExecInfo * exec_info);
 static char *or(char *line, ExecInfo * exec_info);
 static char *and(char *line, ExecInfo * exec_info);
 static char *end_pipe(char *line, ExecInfo * exec_info);
@@ -74,13 +95,35 @@ static char *error(char *line, ExecInfo * exec_info);
 static char *parse_ch(char *line, ExecInfo * exec_info);
 
 static int substitute(char *to_substitute);
+static int substitute_brace(char *expression, ExecInfo * exec_info);
+static int parse_brace_operator(char *operator, char **word, char **word2);
+static int expand_operand(const char *word, char *out, int is_pattern);
+static int apply_brace_operator(const char *value, int operator, char *word,
+				char *word2, char *result);
+static int slice_elements(char **elements, size_t *n, char *offset,
+			  char *length);
+static void paste_sub(int split, ExecInfo * exec_info);
+static void paste_elements(char *const *elements, size_t len, int separate,
+			   ExecInfo * exec_info);
 static void start_file(ExecInfo * exec_info);
 static void new_argument(ExecInfo * exec_info);
+static void copy_buffer_to_arg(Buffer * buffer, ExecInfo * exec_info);
+static int must_split(ExecInfo * exec_info);
+static void split_fields(const char *data, size_t len, ExecInfo * exec_info);
+static int end_field(ExecInfo * exec_info);
 static char *error_token(char token, char *line);
 static int seek(char *line);
 static int seekcmd(char *line);
 static int seekfile(char *line, char filetype);
-static int seeksubexec(char *line);
+static int read_sub_file(char *line, Buffer * buffer);
+static int is_sub_file(char *line);
+static char *seek_subexec_end(char *line);
+static int can_run_concurrently(char *start, char *end);
+static int launch_concurrent_subexec(char *start, char *end);
+static int join_concurrent_subexec(char *line, Buffer * buffer);
+static int launch_process_sub(char *start, char *end,
+			      ExecInfo * exec_info);
+static void expand_alias(struct alias *alias, ExecInfo * exec_info);
 
 static int load_std_table();
 static int load_basic_std_table();
@@ -93,9 +136,28 @@ static int load_dq_table();
 // GLOBAL VARIABLES
 static int has_redirect_to_file = 0;
 static int require_glob = 0;
+// The argument has text from a substitution, it is never an alias
+static int has_expansion = 0;
 static int syntax_error = 0;
 static int exec_depth = 0;
 
+// $() of the current command launched before lexing it
+static struct {
+	char *start;
+	pid_t pid;
+	int fd;
+} concurrent_subs[MAX_CONCURRENT_SUBEXEC];
+static int n_concurrent_subs = 0;
+static int next_concurrent_sub = 0;
+
+// <() and >() of the commands being parsed, closed once launched
+static struct {
+	int fd;
+	int depth;
+	pid_t pid;
+} process_subs[MAX_PROCESS_SUBS];
+static int n_process_subs = 0;
+
 static spec_char std[ASCII_CHARS];
 static spec_char sub[ASCII_CHARS];
 static spec_char file[ASCII_CHARS];
@@ -134,12 +196,12 @@ load_std_table()
 	std['$'] = start_sub;
 	std['&'] = background;
 	std['\''] = start_squote;
-	std['('] = error;
-	std[')'] = error;
+	std['('] = start_array;
+	std[')'] = end_array;
 	std['*'] = do_glob;
 	std[';'] = end_pipe;
-	std['<'] = start_file_in;
-	std['>'] = start_file_out;
+	std['<'] = start_in;
+	std['>'] = start_out;
 	std['?'] = do_glob;
 	std['['] = do_glob;
 	std['\\'] = escape;
@@ -193,7 +255,7 @@ load_sub_table()
 	sub['?'] = copy_and_end_sub;
 	sub['@'] = copy_and_end_sub;
 	sub['\\'] = end_sub;
-	sub['_'] = copy_and_end_sub;
+	sub['_'] = copy_or_end_sub;
 	sub['{'] = end_sub;
 	sub['}'] = end_sub;
 	sub['|'] = end_sub;
@@ -217,8 +279,8 @@ load_file_table()
 	file[')'] = error;
 	file['*'] = do_glob;
 	file[';'] = end_file;
-	file['<'] = end_file;
-	file['>'] = end_file;
+	file['<'] = end_file_or_process_sub;
+	file['>'] = end_file_or_process_sub;
 	file['?'] = do_glob;
 	file['['] = do_glob;
 	file['\\'] = escape;
@@ -340,7 +402,9 @@ parse(char *ptr, ExecInfo * exec_info)
 
 	cmd = exec_info->last_command;
 
-	if (strlen(cmd->current_arg) > 0) {
+	// A field split from an expansion leaves current_arg past its text
+	if (strlen(cmd->current_arg) > 0 || (parse_info->has_arg_started
+					     && *cmd->argv[cmd->argc] != '\0')) {
 		new_argument(exec_info);
 	} else {
 		reset_last_arg(cmd);
@@ -434,6 +498,10 @@ start_sub(char *line, ExecInfo * exec_info)
 		line++;
 		return subexec(line, exec_info);
 	}
+	if (strstr(line, "${") == line) {
+		line++;
+		return brace_sub(line, exec_info);
+	}
 
 	sub_info->old_ptr = parse_info->copy;
 	parse_info->copy = sub_info->buffer;
@@ -468,33 +536,228 @@ end_sub(char *line, ExecInfo * exec_info)
 {
 	ParseInfo *parse_info = exec_info->parse_info;
 	SubInfo *sub_info = exec_info->sub_info;
-	Command *cmd = exec_info->last_command;
+	int result;
 
 	parse_info->curr_lexer = sub_info->old_lexer;
 	parse_info->copy = sub_info->old_ptr;
 
-	switch (substitute(sub_info->buffer)) {
-	case 1:
-		if (parse_info->curr_lexer != &std) {
-			strcpy(parse_info->copy, sub_info->buffer);
-			cmd->current_arg += strlen(cmd->current_arg);
-		} else {
-			parse(sub_info->buffer, exec_info);
-			parse_info->has_arg_started = 0;
+	result = substitute(sub_info->buffer);
+	if (result == 0) {
+		return NULL;
+	}
+	paste_sub(result == 1, exec_info);
+
+	return --line;
+}
+
+// ${name}, ${name[index]}, ${name[@]}, ${name[*]}, ${#name} and ${#name[@]}
+char *
+brace_sub(char *line, ExecInfo * exec_info)
+{
+	SubInfo *sub_info = exec_info->sub_info;
+	char *end;
+	size_t len;
+	int result;
+	int depth = 0;
+
+	// Words of operators can have ${} too
+	for (end = line + 1; *end != '\0'; end++) {
+		if (*end == '{') {
+			depth++;
+		} else if (*end == '}' && depth-- == 0) {
+			break;
 		}
-		break;
-	case 2:
-		strcpy(parse_info->copy, sub_info->buffer);
-		cmd->current_arg += strlen(cmd->current_arg);
-		break;
-	default:
+	}
+	if (*end == '\0') {
+		return error(line, exec_info);
+	}
+	len = end - line - 1;
+	if (len >= MAX_ARGUMENT_SIZE) {
+		fprintf(stderr, "error: bad substitution\n");
 		return NULL;
-		break;
 	}
+	memcpy(sub_info->buffer, line + 1, len);
+	sub_info->buffer[len] = '\0';
 
-	parse_info->copy = cmd->current_arg;
+	result = substitute_brace(sub_info->buffer, exec_info);
+	if (result == 0) {
+		return NULL;
+	}
+	if (result != 3) {
+		paste_sub(result == 1, exec_info);
+	}
+	return end;
+}
 
-	return --line;
+// Copies the result of a substitution in sub_info->buffer to the argument
+static void
+paste_sub(int split, ExecInfo * exec_info)
+{
+	ParseInfo *parse_info = exec_info->parse_info;
+	SubInfo *sub_info = exec_info->sub_info;
+	Command *cmd = exec_info->last_command;
+
+	if (split && must_split(exec_info)) {
+		split_fields(sub_info->buffer, strlen(sub_info->buffer),
+			     exec_info);
+		return;
+	}
+	strcpy(parse_info->copy, sub_info->buffer);
+	cmd->current_arg += strlen(cmd->current_arg);
+	has_expansion = 1;
+
+	if (parse_info->copy >= exec_info->file_info->buffer
+	    && parse_info->copy <
+	    exec_info->file_info->buffer + MAX_ARGUMENT_SIZE) {
+		// Still copying a redirection word
+		parse_info->copy += strlen(parse_info->copy);
+	} else {
+		parse_info->copy = cmd->current_arg;
+	}
+}
+
+// Unset elements are skipped, separate makes each element an argument
+static void
+paste_elements(char *const *elements, size_t len, int separate,
+	       ExecInfo * exec_info)
+{
+	ParseInfo *parse_info = exec_info->parse_info;
+	Command *cmd = exec_info->last_command;
+	Buffer *buffer;
+	size_t i;
+	int pasted = 0;
+
+	if (separate) {
+		for (i = 0; i < len; i++) {
+			if (elements[i] == NULL) {
+				continue;
+			}
+			if (pasted++ > 0) {
+				if (cmd->argc >= MAX_ARGUMENTS - 1) {
+					fprintf(stderr,
+						"Mash: error: array truncated to %d elements\n",
+						pasted - 1);
+					break;
+				}
+				add_arg(cmd);
+				parse_info->copy = cmd->current_arg;
+			}
+			if (parse_info->copy - cmd->argv[cmd->argc] +
+			    strlen(elements[i]) >= MAX_ARGUMENT_SIZE) {
+				fprintf(stderr,
+					"Mash: error: element %ld is too long\n",
+					(long)i);
+				break;
+			}
+			strcpy(parse_info->copy, elements[i]);
+			cmd->current_arg += strlen(cmd->current_arg);
+			parse_info->copy = cmd->current_arg;
+		}
+		return;
+	}
+
+	buffer = new_buffer();
+	for (i = 0; i < len; i++) {
+		if (elements[i] == NULL) {
+			continue;
+		}
+		if ((pasted++ > 0 && append_buffer(buffer, " ", 1) < 0)
+		    || append_buffer(buffer, elements[i],
+				     strlen(elements[i])) < 0) {
+			err(EXIT_FAILURE, "malloc failed");
+		}
+	}
+	if (must_split(exec_info)) {
+		split_fields(buffer->data, buffer->len, exec_info);
+	} else {
+		copy_buffer_to_arg(buffer, exec_info);
+	}
+	free_buffer(buffer);
+}
+
+// Only unquoted words are split, but never the value of an assignment
+static int
+must_split(ExecInfo * exec_info)
+{
+	Command *cmd = exec_info->last_command;
+
+	if (exec_info->parse_info->curr_lexer != &std) {
+		return 0;
+	}
+	return cmd->argc != 0 || strchr(cmd->argv[0], '=') == NULL;
+}
+
+// Splits data on IFS straight into the arguments. Fields are copied as they
+// are, a value with quotes, $, | or > is never syntax
+static void
+split_fields(const char *data, size_t len, ExecInfo * exec_info)
+{
+	ParseInfo *parse_info = exec_info->parse_info;
+	Command *cmd = exec_info->last_command;
+	const char *ifs = get_var("IFS");
+	const char *end = data + len;
+	// Text before the substitution is part of the first field
+	int in_field = parse_info->copy > cmd->argv[cmd->argc];
+
+	if (ifs == NULL) {
+		ifs = " \t\n";
+	}
+
+	for (; data < end; data++) {
+		if (*data == '\0') {
+			continue;
+		} else if (strchr(ifs, *data) == NULL) {
+			if (parse_info->copy - cmd->argv[cmd->argc] >=
+			    MAX_ARGUMENT_SIZE - 1) {
+				fprintf(stderr,
+					"Mash: error: field truncated to %d bytes\n",
+					MAX_ARGUMENT_SIZE - 1);
+				break;
+			}
+			if (*data == '*' || *data == '?' || *data == '[') {
+				require_glob = 1;
+			}
+			*parse_info->copy++ = *data;
+			in_field = 1;
+		} else if (in_field) {
+			// An empty argument would end argv, empty fields are
+			// dropped
+			if (end_field(exec_info) < 0) {
+				return;
+			}
+			in_field = 0;
+		}
+	}
+	*parse_info->copy = '\0';
+	cmd->current_arg = parse_info->copy;
+	parse_info->has_arg_started = in_field;
+	has_expansion = in_field;
+}
+
+static int
+end_field(ExecInfo * exec_info)
+{
+	Command *cmd = exec_info->last_command;
+
+	if (cmd->argc >= MAX_ARGUMENTS - 1) {
+		fprintf(stderr,
+			"Mash: error: fields truncated to %d arguments\n",
+			MAX_ARGUMENTS - 1);
+		return -1;
+	}
+	*exec_info->parse_info->copy = '\0';
+	if (require_glob) {
+		// The pattern is the whole argument, not only this field
+		cmd->current_arg = cmd->argv[cmd->argc];
+		new_argument(exec_info);
+	} else {
+		// Fields never expand aliases
+		has_expansion = 0;
+		add_arg(cmd);
+	}
+	exec_info->parse_info->copy = cmd->current_arg;
+	exec_info->parse_info->has_arg_started = 0;
+	return 0;
 }
 
 int
@@ -509,12 +772,8 @@ substitute(char *to_substitute)
 			sprintf(to_substitute, "%d", getpid());
 			return 2;
 		} else if (*to_substitute == '?') {
-			sub_result = getenv("result");
-			if (sub_result == NULL) {
-				return 0;
-			}
 			memset(to_substitute, 0, MAX_ENV_SIZE);
-			strcpy(to_substitute, sub_result);
+			sprintf(to_substitute, "%d", last_status);
 			return 2;
 		} else if (*to_substitute == '#') {
 			memset(to_substitute, 0, MAX_ENV_SIZE);
@@ -537,11 +796,14 @@ substitute(char *to_substitute)
 		return 2;
 	}
 
-	sub_result = getenv(to_substitute);
+	sub_result = get_var(to_substitute);
 	if (sub_result == NULL) {
 		fprintf(stderr, "error: var %s does not exist\n",
 			to_substitute);
 		return 0;
+	} else if (strlen(sub_result) >= MAX_ARGUMENT_SIZE) {
+		fprintf(stderr, "error: var %s is too long\n", to_substitute);
+		return 0;
 	} else {
 		memset(to_substitute, 0, MAX_ENV_SIZE);
 		strcpy(to_substitute, sub_result);
@@ -549,22 +811,477 @@ substitute(char *to_substitute)
 	return 1;
 }
 
+// Returns like substitute, or 3 if the elements were already pasted
+int
+substitute_brace(char *expression, ExecInfo * exec_info)
+{
+	ParseInfo *parse_info = exec_info->parse_info;
+	char *const *elements = NULL;
+	char **results;
+	char name[MAX_ARGUMENT_SIZE];
+	char result[MAX_ARGUMENT_SIZE];
+	char *subscript = NULL;
+	char *operator;
+	char *word = NULL;
+	char *word2 = NULL;
+	char *value;
+	size_t len = 0;
+	size_t n_results = 0;
+	size_t index;
+	size_t i;
+	int length = 0;
+	int type;
+	int in_file;
+	int exit_code = 3;
+
+	if (*expression == '#' && expression[1] != '\0') {
+		length = 1;
+		expression++;
+	}
+	for (operator = expression; isalnum(*operator) || *operator == '_';
+	     operator++) ;
+	if (operator == expression && expression[1] == '\0'
+	    && strchr("$?#@-", *expression) != NULL) {
+		// ${?} is $?
+		memmove(exec_info->sub_info->buffer, expression, 2);
+		return substitute(exec_info->sub_info->buffer);
+	} else if (operator == expression) {
+		fprintf(stderr, "error: bad substitution\n");
+		return 0;
+	}
+	memcpy(name, expression, operator - expression);
+	name[operator - expression] = '\0';
+
+	if (*operator == '[') {
+		subscript = operator + 1;
+		operator = strchr(subscript, ']');
+		if (operator == NULL) {
+			fprintf(stderr, "error: bad substitution\n");
+			return 0;
+		}
+		*operator++ = '\0';
+	}
+	type = parse_brace_operator(operator, &word, &word2);
+	if (type < 0 || (length && type != BRACE_NONE)) {
+		fprintf(stderr, "error: bad substitution\n");
+		return 0;
+	}
+
+	if (subscript == NULL) {
+		value = get_var(name);
+		if (value == NULL && type != BRACE_DEFAULT) {
+			fprintf(stderr, "error: var %s does not exist\n", name);
+			return 0;
+		}
+	} else if (strcmp(subscript, "@") == 0 || strcmp(subscript, "*") == 0) {
+		elements = get_array(name, &len);
+		if (length) {
+			sprintf(exec_info->sub_info->buffer, "%ld",
+				len > 0 ? count_array(name) : 0L);
+			return 2;
+		}
+
+		// Every set element goes through the operator
+		results = malloc((len + 1) * sizeof(char *));
+		if (results == NULL) {
+			err(EXIT_FAILURE, "malloc failed");
+		}
+		for (i = 0; i < len; i++) {
+			if (elements[i] == NULL) {
+				continue;
+			}
+			if (type == BRACE_NONE || type == BRACE_SUBSTRING
+			    || type == BRACE_DEFAULT) {
+				strcpy(result, elements[i]);
+			} else if (apply_brace_operator(elements[i], type, word,
+							word2, result) < 0) {
+				exit_code = 0;
+				break;
+			}
+			results[n_results] = strdup(result);
+			if (results[n_results++] == NULL) {
+				err(EXIT_FAILURE, "malloc failed");
+			}
+		}
+		if (exit_code != 0 && type == BRACE_SUBSTRING
+		    && slice_elements(results, &n_results, word, word2) < 0) {
+			exit_code = 0;
+		} else if (exit_code != 0 && type == BRACE_DEFAULT
+			   && n_results == 0) {
+			if (expand_operand(word, result, 0) < 0) {
+				exit_code = 0;
+			} else {
+				results[n_results] = strdup(result);
+				if (results[n_results++] == NULL) {
+					err(EXIT_FAILURE, "malloc failed");
+				}
+			}
+		}
+
+		if (exit_code != 0) {
+			in_file = parse_info->copy >= exec_info->file_info->buffer
+			    && parse_info->copy <
+			    exec_info->file_info->buffer + MAX_ARGUMENT_SIZE;
+			// Only "${name[@]}" keeps every element as an argument
+			paste_elements(results, n_results, *subscript == '@'
+				       && parse_info->curr_lexer == &dq
+				       && !in_file, exec_info);
+		}
+		for (i = 0; i < n_results; i++) {
+			free(results[i]);
+		}
+		free(results);
+		return exit_code;
+	} else {
+		// Variables in the subscript can also be written as $name
+		for (value = expression = subscript; *expression != '\0';
+		     expression++) {
+			if (*expression != '$') {
+				*value++ = *expression;
+			}
+		}
+		*value = '\0';
+		if (eval_array_index(name, subscript, &index) < 0) {
+			return 0;
+		}
+		elements = get_array(name, &len);
+		value = index < len && elements[index] != NULL ?
+		    elements[index] : NULL;
+		if (value == NULL && type != BRACE_DEFAULT) {
+			value = "";
+		}
+	}
+
+	if (length) {
+		sprintf(exec_info->sub_info->buffer, "%ld", (long)strlen(value));
+		return 2;
+	} else if (type == BRACE_DEFAULT) {
+		if (value == NULL || *value == '\0') {
+			// word is still in sub_info->buffer
+			if (expand_operand(word, result, 0) < 0) {
+				return 0;
+			}
+			value = result;
+		}
+	} else if (type != BRACE_NONE) {
+		if (apply_brace_operator(value, type, word, word2, result) < 0) {
+			return 0;
+		}
+		value = result;
+	}
+
+	if (strlen(value) >= MAX_ARGUMENT_SIZE) {
+		fprintf(stderr, "error: var %s is too long\n", name);
+		return 0;
+	}
+	strcpy(exec_info->sub_info->buffer, value);
+	return 1;
+}
+
+// Splits the words of the operator in place
+static int
+parse_brace_operator(char *operator, char **word, char **word2)
+{
+	char *separator;
+
+	*word = operator + 1;
+	*word2 = NULL;
+	switch (*operator) {
+	case '\0':
+		return BRACE_NONE;
+	case '#':
+	case '%':
+		if (operator[1] == *operator) {
+			(*word)++;
+			return *operator == '#' ? BRACE_LONGEST_PREFIX :
+			    BRACE_LONGEST_SUFFIX;
+		}
+		return *operator == '#' ? BRACE_PREFIX : BRACE_SUFFIX;
+	case '/':
+		if (operator[1] == '/' || operator[1] == '#'
+		    || operator[1] == '%') {
+			(*word)++;
+		}
+		// \/ is part of the pattern
+		for (separator = *word; *separator != '\0'
+		     && *separator != '/'; separator++) {
+			if (*separator == '\\' && separator[1] != '\0') {
+				separator++;
+			}
+		}
+		*word2 = "";
+		if (*separator == '/') {
+			*separator = '\0';
+			*word2 = separator + 1;
+		}
+		switch (operator[1]) {
+		case '/':
+			return BRACE_REPLACE_ALL;
+		case '#':
+			return BRACE_REPLACE_PREFIX;
+		case '%':
+			return BRACE_REPLACE_SUFFIX;
+		}
+		return BRACE_REPLACE;
+	case ':':
+		if (operator[1] == '-') {
+			(*word)++;
+			return BRACE_DEFAULT;
+		}
+		separator = strchr(*word, ':');
+		if (separator != NULL) {
+			*separator = '\0';
+			*word2 = separator + 1;
+		}
+		return BRACE_SUBSTRING;
+	}
+	return -1;
+}
+
+// $name and ${name} are expanded, quotes are removed. In patterns the
+// quoted wildcards are escaped so they only match themselves
+static int
+expand_operand(const char *word, char *out, int is_pattern)
+{
+	char *start = out;
+	char *end = out + MAX_ARGUMENT_SIZE - 1;
+	char name[MAX_ARGUMENT_SIZE];
+	const char *value;
+	char quote = '\0';
+	size_t len;
+
+	for (; *word != '\0' && out < end; word++) {
+		if (quote == '\0' && (*word == '"' || *word == '\'')) {
+			quote = *word;
+		} else if (*word == quote) {
+			quote = '\0';
+		} else if (*word == '$' && quote != '\'' && (word[1] == '{'
+							    || isalnum(word[1])
+							    || word[1] == '_')) {
+			word += word[1] == '{' ? 2 : 1;
+			for (len = 0; isalnum(word[len]) || word[len] == '_';
+			     len++) {
+				name[len] = word[len];
+			}
+			name[len] = '\0';
+			word += len;
+			if (word[-len - 1] == '{' && *word++ != '}') {
+				fprintf(stderr, "error: bad substitution\n");
+				return -1;
+			}
+			word--;
+			value = get_var(name);
+			if (value == NULL) {
+				value = "";
+			}
+			for (; *value != '\0' && out < end; value++) {
+				if (is_pattern && quote != '\0'
+				    && strchr("*?[\\", *value) != NULL) {
+					*out++ = '\\';
+				}
+				*out++ = *value;
+			}
+		} else if (*word == '\\' && quote != '\'' && word[1] != '\0') {
+			if (is_pattern) {
+				*out++ = *word;
+			}
+			*out++ = *++word;
+		} else {
+			if (is_pattern && quote != '\0'
+			    && strchr("*?[\\", *word) != NULL) {
+				*out++ = '\\';
+			}
+			*out++ = *word;
+		}
+	}
+	if (out >= end) {
+		fprintf(stderr, "error: bad substitution\n");
+		return -1;
+	}
+	*out = '\0';
+	return out - start;
+}
+
+static int
+apply_brace_operator(const char *value, int operator, char *word,
+		     char *word2, char *result)
+{
+	char pattern_source[MAX_ARGUMENT_SIZE];
+	char replacement[MAX_ARGUMENT_SIZE];
+	char number[MAX_ARGUMENT_SIZE];
+	Pattern *pattern = NULL;
+	const char *match;
+	size_t match_len;
+	size_t used = 0;
+	size_t len = strlen(value);
+	long long offset;
+	long long length;
+	long affix;
+
+	if (operator != BRACE_SUBSTRING) {
+		if (expand_operand(word, pattern_source, 1) < 0) {
+			return -1;
+		}
+		pattern = get_pattern(pattern_source);
+	}
+
+	switch (operator) {
+	case BRACE_PREFIX:
+	case BRACE_LONGEST_PREFIX:
+		affix = match_affix(pattern, value, 0,
+				    operator == BRACE_LONGEST_PREFIX);
+		strcpy(result, value + (affix < 0 ? 0 : affix));
+		break;
+	case BRACE_SUFFIX:
+	case BRACE_LONGEST_SUFFIX:
+		affix = match_affix(pattern, value, 1,
+				    operator == BRACE_LONGEST_SUFFIX);
+		len -= affix < 0 ? 0 : affix;
+		memcpy(result, value, len);
+		result[len] = '\0';
+		break;
+	case BRACE_REPLACE:
+	case BRACE_REPLACE_ALL:
+		if (expand_operand(word2, replacement, 0) < 0) {
+			return -1;
+		}
+		while ((match = find_pattern(pattern, value, &match_len))) {
+			if (used + (match - value) + strlen(replacement) >=
+			    MAX_ARGUMENT_SIZE) {
+				fprintf(stderr, "error: substitution is too long\n");
+				return -1;
+			}
+			memcpy(result + used, value, match - value);
+			used += match - value;
+			strcpy(result + used, replacement);
+			used += strlen(replacement);
+			value = match + match_len;
+			if (operator == BRACE_REPLACE) {
+				break;
+			}
+		}
+		if (used + strlen(value) >= MAX_ARGUMENT_SIZE) {
+			fprintf(stderr, "error: substitution is too long\n");
+			return -1;
+		}
+		strcpy(result + used, value);
+		break;
+	case BRACE_REPLACE_PREFIX:
+	case BRACE_REPLACE_SUFFIX:
+		if (expand_operand(word2, replacement, 0) < 0) {
+			return -1;
+		}
+		affix = match_affix(pattern, value,
+				    operator == BRACE_REPLACE_SUFFIX, 1);
+		if (affix < 0) {
+			strcpy(result, value);
+			break;
+		}
+		if (len - affix + strlen(replacement) >= MAX_ARGUMENT_SIZE) {
+			fprintf(stderr, "error: substitution is too long\n");
+			return -1;
+		}
+		if (operator == BRACE_REPLACE_PREFIX) {
+			strcpy(result, replacement);
+			strcat(result, value + affix);
+		} else {
+			memcpy(result, value, len - affix);
+			strcpy(result + len - affix, replacement);
+		}
+		break;
+	case BRACE_SUBSTRING:
+		if (expand_operand(word, number, 0) < 0
+		    || eval_math(number, &offset, STDERR_FILENO) < 0) {
+			return -1;
+		}
+		if (offset < 0) {
+			offset = (long long)len + offset < 0 ? 0 : len + offset;
+		} else if (offset > (long long)len) {
+			offset = len;
+		}
+		length = len - offset;
+		if (word2 != NULL) {
+			if (expand_operand(word2, number, 0) < 0
+			    || eval_math(number, &length, STDERR_FILENO) < 0) {
+				return -1;
+			}
+			if (length < 0) {
+				// From the end
+				length += len - offset;
+				if (length < 0) {
+					fprintf(stderr,
+						"error: %s: substring expression < 0\n",
+						number);
+					return -1;
+				}
+			} else if (length > (long long)len - offset) {
+				length = len - offset;
+			}
+		}
+		memcpy(result, value + offset, length);
+		result[length] = '\0';
+		break;
+	}
+	return 0;
+}
+
+// ${name[@]:offset:length} takes elements instead of chars
+static int
+slice_elements(char **elements, size_t *n, char *offset, char *length)
+{
+	char number[MAX_ARGUMENT_SIZE];
+	long long first;
+	long long count;
+	size_t i;
+
+	if (expand_operand(offset, number, 0) < 0
+	    || eval_math(number, &first, STDERR_FILENO) < 0) {
+		return -1;
+	}
+	if (first < 0) {
+		first = (long long)*n + first < 0 ? 0 : *n + first;
+	} else if (first > (long long)*n) {
+		first = *n;
+	}
+	count = *n - first;
+	if (length != NULL) {
+		if (expand_operand(length, number, 0) < 0
+		    || eval_math(number, &count, STDERR_FILENO) < 0) {
+			return -1;
+		}
+		if (count < 0) {
+			fprintf(stderr, "error: %s: substring expression < 0\n",
+				number);
+			return -1;
+		}
+		if (count > (long long)*n - first) {
+			count = *n - first;
+		}
+	}
+
+	for (i = 0; i < (size_t)first; i++) {
+		free(elements[i]);
+	}
+	for (i = first + count; i < *n; i++) {
+		free(elements[i]);
+	}
+	memmove(elements, elements + first, count * sizeof(char *));
+	*n = count;
+	return 0;
+}
+
 char *
 subexec(char *line, ExecInfo * exec_info)
 {
 	ParseInfo *parse_info = exec_info->parse_info;
-	Command *cmd = exec_info->last_command;
 	int n_parenthesis = 1;
 	int in_math = 0;
+	char *sub_start = line;
 
 	exec_depth++;
 
 	// Read again and parse until )
-	char *buffer = malloc(1024);
-
-	if (buffer == NULL)
-		err(EXIT_FAILURE, "malloc failed");
-	memset(buffer, 0, 1024);
+	Buffer *buffer = new_buffer();
 
 	// Store all in line_buf
 	char *line_buf = malloc(1024);
@@ -623,43 +1340,469 @@ subexec(char *line, ExecInfo * exec_info)
 			break;
 		}
 	}
-	find_command(line_buf, buffer, stdin, exec_info, NULL);
+	if (!join_concurrent_subexec(sub_start, buffer)
+	    && !read_sub_file(line_buf, buffer)) {
+		find_command(line_buf, buffer, stdin, exec_info, NULL);
+	}
 
 	if (syntax_error) {
+		exec_depth--;
 		parse_info->finished = 1;
 		free(line_buf);
-		free(buffer);
+		free_buffer(buffer);
 		return NULL;
 	}
 
 	exec_depth--;
 	parse_info->copy = old_ptr;
 
-	if (parse_info->curr_lexer != &std || seeksubexec(++ptr)) {
-		if (buffer[strlen(buffer) - 1] == '\n') {
-			buffer[strlen(buffer) - 1] = '\0';
-		}
-		strcpy(parse_info->copy, buffer);
-		cmd->current_arg += strlen(cmd->current_arg);
-		parse_info->copy = cmd->current_arg;
+	chomp_buffer(buffer);
+	if (must_split(exec_info)) {
+		split_fields(buffer->data, buffer->len, exec_info);
 	} else {
-		parse(buffer, exec_info);
-		parse_info->has_arg_started = 0;
+		copy_buffer_to_arg(buffer, exec_info);
 	}
-	ptr--;
 
 	free(line_buf);
-	free(buffer);
+	free_buffer(buffer);
 	return ptr;
 }
 
+// <(cmd) and >(cmd) become a /dev/fd path to a pipe from or to cmd
+char *
+process_sub(char *line, ExecInfo * exec_info)
+{
+	ParseInfo *parse_info = exec_info->parse_info;
+	char *end = seek_subexec_end(line + 2);
+	int fd;
+
+	if (end == NULL) {
+		return error_token(*line, line);
+	}
+	if ((fd = launch_process_sub(line, end, exec_info)) < 0) {
+		fprintf(stderr,
+			"Mash: error: failed to launch process substitution\n");
+		return NULL;
+	}
+	parse_info->copy += sprintf(parse_info->copy, "/dev/fd/%d", fd);
+	parse_info->has_arg_started = 1;
+	return end;
+}
+
+int
+launch_process_sub(char *start, char *end, ExecInfo * exec_info)
+{
+	int fd[2];
+	int i;
+	int is_input = *start == '<';
+	int shell_fd;
+	pid_t pid;
+	char *sub_line;
+	char job_line[MAX_ARGUMENT_SIZE];
+	Job *job;
+
+	if (n_process_subs >= MAX_PROCESS_SUBS || pipe(fd) < 0) {
+		return -1;
+	}
+	fflush(stdout);
+	switch (pid = fork()) {
+	case -1:
+		close_fd(fd[0]);
+		close_fd(fd[1]);
+		return -1;
+	case 0:
+		// Pipes of the command or other substitutions must not wait
+		// for this one to end
+		close_all_fd(exec_info->command);
+		for (i = 0; i < n_process_subs; i++) {
+			close_fd(process_subs[i].fd);
+		}
+		n_process_subs = 0;
+		if (is_input) {
+			close_fd(fd[0]);
+			if (dup2(fd[1], STDOUT_FILENO) == -1) {
+				err(EXIT_FAILURE, "Failed to dup stdout");
+			}
+			close_fd(fd[1]);
+			if (reading_from_file) {
+				close(STDIN_FILENO);
+				open("/dev/null", O_RDONLY);
+			}
+		} else {
+			close_fd(fd[1]);
+			if (dup2(fd[0], STDIN_FILENO) == -1) {
+				err(EXIT_FAILURE, "Failed to dup stdin");
+			}
+			close_fd(fd[0]);
+			// Its commands have to read the pipe, not /dev/null
+			reading_from_file = 0;
+		}
+		sub_line = malloc(MAX_ARGUMENT_SIZE);
+		if (sub_line == NULL) {
+			err(EXIT_FAILURE, "malloc failed");
+		}
+		memset(sub_line, 0, MAX_ARGUMENT_SIZE);
+		strncpy(sub_line, start + 2, end - start - 2);
+		exec_depth++;
+		exit(find_command(sub_line, NULL, stdin, NULL, NULL));
+	default:
+		if (is_input) {
+			close_fd(fd[1]);
+			shell_fd = fd[0];
+		} else {
+			close_fd(fd[0]);
+			shell_fd = fd[1];
+		}
+		process_subs[n_process_subs].fd = shell_fd;
+		process_subs[n_process_subs].depth = exec_depth;
+		process_subs[n_process_subs].pid = pid;
+		n_process_subs++;
+
+		if (use_job_control) {
+			snprintf(job_line, MAX_ARGUMENT_SIZE, "%.*s",
+				 (int)(end - start + 1), start);
+			job = new_job(job_line);
+			job->pid = pid;
+			job->end_pid = pid;
+			job->execution = SUB_EXECUTION;
+			add_job(job);
+		}
+		return shell_fd;
+	}
+}
+
+void
+end_process_subs()
+{
+	Job *job;
+	pid_t pid;
+
+	// Nested commands only close their own
+	while (n_process_subs > 0
+	       && process_subs[n_process_subs - 1].depth >= exec_depth) {
+		n_process_subs--;
+		close_fd(process_subs[n_process_subs].fd);
+		pid = process_subs[n_process_subs].pid;
+		// Still running ones are removed by update_jobs
+		if (waitpid(pid, NULL, WNOHANG) != 0 && use_job_control
+		    && (job = get_job(pid)) != NULL) {
+			remove_job(job);
+		}
+	}
+}
+
+int
+start_concurrent_subexecs(char *line)
+{
+	char *ptr;
+	char *end;
+	int in_dquote = 0;
+	int n_found = 0;
+	char *found_start[MAX_CONCURRENT_SUBEXEC];
+	char *found_end[MAX_CONCURRENT_SUBEXEC];
+	int i;
+
+	if (!concurrent_subexec || syntax_mode != EXTENDED_SYNTAX
+	    || exec_depth > 0 || n_concurrent_subs > 0 || line == NULL) {
+		return 0;
+	}
+	// Only look until the end of this command, the next ones could
+	// depend on what this one does
+	for (ptr = line; *ptr != '\0'; ptr++) {
+		switch (*ptr) {
+		case '\\':
+			if (*++ptr == '\0') {
+				ptr--;
+			}
+			break;
+		case '\'':
+			if (!in_dquote && (ptr = strchr(ptr + 1, '\'')) == NULL) {
+				goto launch;
+			}
+			break;
+		case '"':
+			in_dquote = !in_dquote;
+			break;
+		case '#':
+		case ';':
+			if (!in_dquote) {
+				goto launch;
+			}
+			break;
+		case '&':
+			if (!in_dquote && ptr[1] != '>') {
+				goto launch;
+			}
+			break;
+		case '|':
+			if (!in_dquote && ptr[1] == '|') {
+				goto launch;
+			}
+			break;
+		case '$':
+			if (*++ptr != '(') {
+				ptr--;
+				break;
+			}
+			if ((end = seek_subexec_end(ptr + 1)) == NULL) {
+				goto launch;
+			}
+			if (n_found < MAX_CONCURRENT_SUBEXEC
+			    && can_run_concurrently(ptr + 1, end)) {
+				found_start[n_found] = ptr;
+				found_end[n_found] = end;
+				n_found++;
+			}
+			ptr = end;
+			break;
+		}
+	}
+
+ launch:
+	// A single one would just be waited for as before
+	if (n_found < 2) {
+		return 0;
+	}
+	for (i = 0; i < n_found; i++) {
+		launch_concurrent_subexec(found_start[i], found_end[i]);
+	}
+	return n_concurrent_subs;
+}
+
+void
+end_concurrent_subexecs()
+{
+	// Results not used because the command was not fully parsed
+	for (; next_concurrent_sub < n_concurrent_subs; next_concurrent_sub++) {
+		close_fd(concurrent_subs[next_concurrent_sub].fd);
+		kill(concurrent_subs[next_concurrent_sub].pid, SIGTERM);
+		waitpid(concurrent_subs[next_concurrent_sub].pid, NULL, 0);
+	}
+	n_concurrent_subs = 0;
+	next_concurrent_sub = 0;
+}
+
+char *
+seek_subexec_end(char *line)
+{
+	// Same rule as subexec: count every parenthesis
+	int n_parenthesis = 1;
+
+	for (; *line != '\0'; line++) {
+		if (*line == '(') {
+			n_parenthesis++;
+		} else if (*line == ')' && --n_parenthesis == 0) {
+			return line;
+		}
+	}
+	return NULL;
+}
+
+int
+can_run_concurrently(char *start, char *end)
+{
+	char *ptr;
+	char name[MAX_ARGUMENT_SIZE];
+	int len;
+
+	for (ptr = start; ptr < end && (*ptr == ' ' || *ptr == '\t'); ptr++) ;
+	// $(( )) and $(< file) never create a process
+	if (*ptr == '(' || *ptr == '<') {
+		return 0;
+	}
+	// Neither do simple output only builtins
+	len = strcspn(ptr, " \t)");
+	if (len >= MAX_ARGUMENT_SIZE) {
+		return 1;
+	}
+	memcpy(name, ptr, len);
+	name[len] = '\0';
+	if (is_builtin_in_buffer(name)) {
+		for (; ptr < end && strchr("|;&<>$`", *ptr) == NULL; ptr++) ;
+		return ptr != end;
+	}
+	return 1;
+}
+
+int
+launch_concurrent_subexec(char *start, char *end)
+{
+	int fd[2];
+	int i;
+	pid_t pid;
+	char *sub_line;
+
+	if (pipe(fd) < 0) {
+		return -1;
+	}
+	switch (pid = fork()) {
+	case -1:
+		close_fd(fd[0]);
+		close_fd(fd[1]);
+		return -1;
+	case 0:
+		// Run it as a subshell writing to the pipe
+		for (i = 0; i < n_concurrent_subs; i++) {
+			close_fd(concurrent_subs[i].fd);
+		}
+		n_concurrent_subs = 0;
+		close_fd(fd[0]);
+		if (dup2(fd[1], STDOUT_FILENO) == -1) {
+			err(EXIT_FAILURE, "Failed to dup stdout");
+		}
+		close_fd(fd[1]);
+		if (reading_from_file) {
+			close(STDIN_FILENO);
+			open("/dev/null", O_RDONLY);
+		}
+		sub_line = malloc(MAX_ARGUMENT_SIZE);
+		if (sub_line == NULL) {
+			err(EXIT_FAILURE, "malloc failed");
+		}
+		memset(sub_line, 0, MAX_ARGUMENT_SIZE);
+		strncpy(sub_line, start + 1, end - start - 1);
+		exec_depth++;
+		exit(find_command(sub_line, NULL, stdin, NULL, NULL));
+	default:
+		close_fd(fd[1]);
+		concurrent_subs[n_concurrent_subs].start = start;
+		concurrent_subs[n_concurrent_subs].pid = pid;
+		concurrent_subs[n_concurrent_subs].fd = fd[0];
+		n_concurrent_subs++;
+		return 0;
+	}
+}
+
+int
+join_concurrent_subexec(char *line, Buffer * buffer)
+{
+	int i = next_concurrent_sub;
+
+	if (i >= n_concurrent_subs || concurrent_subs[i].start != line) {
+		return 0;
+	}
+	if (read_to_buffer(buffer, concurrent_subs[i].fd) < 0) {
+		fprintf(stderr, "Mash: error: failed to read command output\n");
+	}
+	close_fd(concurrent_subs[i].fd);
+	waitpid(concurrent_subs[i].pid, NULL, 0);
+	next_concurrent_sub++;
+	return 1;
+}
+
+// $(< file) is replaced by the contents of file, read without a command
+int
+read_sub_file(char *line, Buffer * buffer)
+{
+	ExecInfo *file_exec_info;
+	Command *cmd;
+
+	for (; *line == ' ' || *line == '\t' || *line == '\n'; line++) ;
+	if (!is_sub_file(line)) {
+		return 0;
+	}
+	// Let the lexer expand and open the file name
+	file_exec_info = new_exec_info(line);
+	parse(line, file_exec_info);
+	cmd = file_exec_info->command;
+
+	if (strlen(cmd->argv[0]) == 0 && cmd->input > STDIN_FILENO) {
+		if (read_to_buffer(buffer, cmd->input) < 0) {
+			fprintf(stderr, "Mash: error: failed to read file\n");
+		}
+	}
+	close_all_fd(cmd);
+
+	free(file_exec_info->parse_info);
+	free(file_exec_info->file_info);
+	free(file_exec_info->sub_info);
+	free_command(cmd);
+	free(file_exec_info);
+	return 1;
+}
+
+// Only a single < and one word, anything else is run as a command and must
+// not be parsed before
+static int
+is_sub_file(char *line)
+{
+	char quote = '\0';
+
+	if (*line != '<' || line[1] == '<' || line[1] == '(') {
+		return 0;
+	}
+	for (line++; *line == ' ' || *line == '\t'; line++) ;
+	if (*line == '\0' || *line == '\n') {
+		return 0;
+	}
+	for (; *line != '\0'; line++) {
+		if (quote != '\'' && *line == '$' && line[1] == '(') {
+			// A substitution in the word runs once, with the word
+			if ((line = seek_subexec_end(line + 2)) == NULL) {
+				return 0;
+			}
+		} else if (quote != '\0') {
+			if (*line == quote) {
+				quote = '\0';
+			} else if (*line == '\\' && quote == '"' && line[1] != '\0') {
+				line++;
+			}
+		} else if (*line == '\'' || *line == '"') {
+			quote = *line;
+		} else if (*line == '\\' && line[1] != '\0') {
+			line++;
+		} else if (*line == ' ' || *line == '\t' || *line == '\n') {
+			break;
+		} else if (strchr(";&|<>()", *line) != NULL) {
+			return 0;
+		}
+	}
+	for (; *line == ' ' || *line == '\t' || *line == '\n'; line++) ;
+	return *line == '\0' && quote == '\0';
+}
+
+void
+copy_buffer_to_arg(Buffer * buffer, ExecInfo * exec_info)
+{
+	Command *cmd = exec_info->last_command;
+	char *start = cmd->argv[cmd->argc];
+	size_t used;
+	size_t to_copy = strnlen(buffer->data, buffer->len);
+
+	if (exec_info->parse_info->copy < start
+	    || exec_info->parse_info->copy >= start + MAX_ARGUMENT_SIZE) {
+		// Copying into a redirection file name
+		start = exec_info->file_info->buffer;
+	}
+	used = exec_info->parse_info->copy - start;
+
+	// Output may be larger than an argument or contain '\0' bytes
+	if (used + to_copy > MAX_ARGUMENT_SIZE - 1) {
+		fprintf(stderr,
+			"Mash: error: command output truncated to %d bytes\n",
+			MAX_ARGUMENT_SIZE - 1);
+		to_copy = MAX_ARGUMENT_SIZE - 1 - used;
+	}
+	memcpy(exec_info->parse_info->copy, buffer->data, to_copy);
+	exec_info->parse_info->copy[to_copy] = '\0';
+	has_expansion = 1;
+	cmd->current_arg += strlen(cmd->current_arg);
+	exec_info->parse_info->copy = cmd->current_arg;
+}
+
 void
 new_argument(ExecInfo * exec_info)
 {
 	Command *cmd = exec_info->last_command;
+	struct alias *alias;
+	int is_expansion = has_expansion;
 
+	has_expansion = 0;
 	if (require_glob) {
 		require_glob = 0;
+		// current_arg may be past a substitution, the pattern is the
+		// whole argument
+		cmd->current_arg = cmd->argv[cmd->argc];
 		// Do substitution and update command
 		glob_t gstruct;
 
@@ -680,28 +1823,58 @@ new_argument(ExecInfo * exec_info)
 				add_arg(cmd);
 				found++;
 			}
+		} else {
+			add_arg(cmd);
 		}
 
 		globfree(&gstruct);
-		add_arg(cmd);
 		return;
 	}
 
-	if (strcmp(exec_info->sub_info->last_alias, cmd->argv[0]) != 0) {
-		if (check_alias_cmd(cmd)) {
-			strcpy(exec_info->sub_info->last_alias, cmd->argv[0]);
-
-			reset_last_arg(cmd);
-			cmd->argc = 0;
-			cmd->current_arg = cmd->argv[0];
-			parse(get_alias(exec_info->sub_info->last_alias),
-			      exec_info);
+	if (!is_expansion && cmd->argc == 0) {
+		alias = find_alias(cmd->argv[0]);
+		if (alias != NULL && !alias->is_expanding) {
+			expand_alias(alias, exec_info);
 			return;
 		}
 	}
 	add_arg(exec_info->last_command);
 }
 
+// The alias is the first word of the command
+static void
+expand_alias(struct alias *alias, ExecInfo * exec_info)
+{
+	Command *cmd = exec_info->last_command;
+	struct alias *next;
+	int i;
+
+	alias->is_expanding = 1;
+	if (alias->words == NULL) {
+		reset_last_arg(cmd);
+		cmd->argc = 0;
+		cmd->current_arg = cmd->argv[0];
+		parse(alias->reference, exec_info);
+		alias->is_expanding = 0;
+		return;
+	}
+
+	strcpy(cmd->argv[0], alias->words[0]);
+	next = find_alias(alias->words[0]);
+	if (next != NULL && !next->is_expanding) {
+		expand_alias(next, exec_info);
+	} else {
+		add_arg(cmd);
+	}
+	for (i = 1; i < alias->n_words; i++) {
+		strcpy(cmd->current_arg, alias->words[i]);
+		if (!add_arg(cmd)) {
+			break;
+		}
+	}
+	alias->is_expanding = 0;
+}
+
 char *
 here_doc(char *line, ExecInfo * exec_info)
 {
@@ -744,6 +1917,7 @@ start_file(ExecInfo * exec_info)
 	parse_info->old_lexer = parse_info->curr_lexer;
 	parse_info->curr_lexer = &file;
 
+	memset(exec_info->file_info->buffer, 0, MAX_ARGUMENT_SIZE);
 	parse_info->copy = exec_info->file_info->buffer;
 
 	parse_info->has_arg_started = 0;
@@ -752,11 +1926,57 @@ start_file(ExecInfo * exec_info)
 	return;
 }
 
+char *
+start_in(char *line, ExecInfo * exec_info)
+{
+	if (line[1] == '(') {
+		return process_sub(line, exec_info);
+	}
+	if (strstr(line, "<<<") == line) {
+		return start_here_string(line, exec_info);
+	}
+	return start_file_in(line, exec_info);
+}
+
+// <<< word, the word is written to the command input
+char *
+start_here_string(char *line, ExecInfo * exec_info)
+{
+	start_file(exec_info);
+	exec_info->file_info->mode = HERE_STRING_READ;
+	exec_info->file_info->fd = STDIN_FILENO;
+
+	return line + 2;
+}
+
+char *
+start_out(char *line, ExecInfo * exec_info)
+{
+	if (line[1] == '(') {
+		return process_sub(line, exec_info);
+	}
+	return start_file_out(line, exec_info);
+}
+
 char *
 start_file_in(char *line, ExecInfo * exec_info)
 {
+	FileInfo *file_info = exec_info->file_info;
+
 	start_file(exec_info);
-	exec_info->file_info->mode = INPUT_READ;
+	file_info->mode = INPUT_READ;
+	file_info->fd = STDIN_FILENO;
+	take_fd_prefix(exec_info);
+
+	if (line[1] == '>') {
+		// n<> file, opened for reading and writing
+		file_info->mode = READ_WRITE;
+		line++;
+	} else if (line[1] == '&') {
+		// n<&m
+		file_info->mode = DUPLICATE_FD;
+		line++;
+	}
 
 	return line;
 }
@@ -764,7 +1984,10 @@ start_file_in(char *line, ExecInfo * exec_info)
 char *
 basic_start_file_in(char *line, ExecInfo * exec_info)
 {
-	return start_file_in(line, exec_info);
+	start_file(exec_info);
+	exec_info->file_info->mode = INPUT_READ;
+	exec_info->file_info->fd = STDIN_FILENO;
+	return line;
 }
 
 char *
@@ -775,14 +1998,26 @@ start_file_out(char *line, ExecInfo * exec_info)
 
 	start_file(exec_info);
 	file_info->mode = OUTPUT_WRITE;
-	if (strcmp(cmd->current_arg, "2") == 0) {
-		reset_last_arg(cmd);
-		file_info->mode = ERROR_WRITE;
-	} else if (strcmp(cmd->current_arg, "&") == 0) {
-		reset_last_arg(cmd);
+	file_info->fd = STDOUT_FILENO;
+	if (strcmp(cmd->current_arg, "&") == 0) {
+		memset(cmd->current_arg, 0, strlen(cmd->current_arg));
 		file_info->mode = ERROR_AND_OUTPUT_WRITE;
-	} else if (strcmp(cmd->current_arg, "1") == 0) {
-		reset_last_arg(cmd);
+	} else {
+		take_fd_prefix(exec_info);
+	}
+
+	if (line[1] == '>') {
+		// n>> file
+		if (file_info->mode == ERROR_AND_OUTPUT_WRITE) {
+			file_info->mode = ERROR_AND_OUTPUT_APPEND;
+		} else {
+			file_info->mode = APPEND_WRITE;
+		}
+		line++;
+	} else if (line[1] == '&' && file_info->mode == OUTPUT_WRITE) {
+		// n>&m
+		file_info->mode = DUPLICATE_FD;
+		line++;
 	}
 
 	return line;
@@ -793,9 +2028,26 @@ basic_start_file_out(char *line, ExecInfo * exec_info)
 {
 	start_file(exec_info);
 	exec_info->file_info->mode = OUTPUT_WRITE;
+	exec_info->file_info->fd = STDOUT_FILENO;
 	return line;
 }
 
+// A word made only of digits just before < or > is the fd to redirect: 2>
+static void
+take_fd_prefix(ExecInfo * exec_info)
+{
+	Command *cmd = exec_info->last_command;
+	size_t len = strlen(cmd->current_arg);
+
+	if (len == 0 || len > MAX_FD_DIGITS
+	    || strspn(cmd->current_arg, "0123456789") != len) {
+		return;
+	}
+	exec_info->file_info->fd = atoi(cmd->current_arg);
+	// Clear the word in place, it is not an argument
+	memset(cmd->current_arg, 0, len);
+}
+
 char *
 end_file(char *line, ExecInfo * exec_info)
 {
@@ -813,12 +2065,18 @@ end_file(char *line, ExecInfo * exec_info)
 		return error_token(*line, line);
 	}
 
-	if (file_info->mode == INPUT_READ) {
+	if (file_info->fd == STDIN_FILENO) {
 		cmd = exec_info->command;
 	} else {
 		cmd = exec_info->last_command;
 	}
 
+	if (file_info->mode == HERE_STRING_READ
+	    || file_info->mode == DUPLICATE_FD) {
+		// Not a file name
+		require_glob = 0;
+	}
+
 	if (require_glob) {
 		require_glob = 0;
 		if (glob(file_info->buffer, GLOB_ERR, NULL, &gstruct) ==
@@ -846,7 +2104,8 @@ end_file(char *line, ExecInfo * exec_info)
 		globfree(&gstruct);
 	}
 
-	if (set_file_cmd(cmd, file_info->mode, file_info->buffer) < 0) {
+	if (set_fd_cmd(cmd, file_info->fd, file_info->mode, file_info->buffer)
+	    < 0) {
 		return NULL;
 	}
 
@@ -857,6 +2116,16 @@ end_file(char *line, ExecInfo * exec_info)
 	return --line;
 }
 
+// Redirections can also read from or write to a process: > >(cmd)
+char *
+end_file_or_process_sub(char *line, ExecInfo * exec_info)
+{
+	if (line[1] == '(' && !exec_info->parse_info->has_arg_started) {
+		return process_sub(line, exec_info);
+	}
+	return end_file(line, exec_info);
+}
+
 char *
 end_basic_file(char *line, ExecInfo * exec_info)
 {
@@ -945,7 +2214,6 @@ pipe_tok(char *line, ExecInfo * exec_info)
 	exec_info->last_command = new_command();
 
 	// Update old_cmd pipe
-	strcpy(exec_info->sub_info->last_alias, "");
 	pipe_command(old_cmd, exec_info->last_command);
 	parse_info->copy = exec_info->last_command->current_arg;
 
@@ -974,7 +2242,6 @@ basic_pipe_tok(char *line, ExecInfo * exec_info)
 	exec_info->last_command = new_command();
 
 	// Update old_cmd pipe
-	strcpy(exec_info->sub_info->last_alias, "");
 	pipe_command(old_cmd, exec_info->last_command);
 	parse_info->copy = exec_info->last_command->current_arg;
 
@@ -1095,7 +2362,7 @@ end_line(char *line, ExecInfo * exec_info)
 {
 	if (exec_info->parse_info->request_line) {
 		memset(exec_info->line, 0, MAX_ARGUMENT_SIZE);
-		fgets(exec_info->line, MAX_ARGUMENT_SIZE, stdin);
+		read_script_line(exec_info->line, MAX_ARGUMENT_SIZE);
 
 		if (ferror(stdin)) {
 			fprintf(stderr, "Error: fgets failed");
@@ -1122,7 +2389,7 @@ comment(char *line, ExecInfo * exec_info)
 	}
 	memset(line_buf, 0, 1024);
 	while (!exec_info->parse_info->request_line) {
-		fgets(line_buf, MAX_ARGUMENT_SIZE, stdin);
+		read_script_line(line_buf, MAX_ARGUMENT_SIZE);
 
 		if (ferror(stdin)) {
 			fprintf(stderr, "Error: fgets failed");
@@ -1140,6 +2407,43 @@ comment(char *line, ExecInfo * exec_info)
 	return line;
 }
 
+// name=( starts the elements of an array, each one is an argument
+char *
+start_array(char *line, ExecInfo * exec_info)
+{
+	ParseInfo *parse_info = exec_info->parse_info;
+	Command *cmd = exec_info->last_command;
+	char *eq = strchr(cmd->argv[0], '=');
+
+	if (cmd->argc != 0 || cmd->array_assignment != NO_ARRAY_ASSIGNMENT
+	    || eq == NULL || parse_info->copy != eq + 1) {
+		return error(line, exec_info);
+	}
+	cmd->array_assignment = ARRAY_ASSIGNMENT_OPEN;
+	add_arg(cmd);
+	parse_info->copy = cmd->current_arg;
+	parse_info->has_arg_started = 0;
+	return line;
+}
+
+char *
+end_array(char *line, ExecInfo * exec_info)
+{
+	ParseInfo *parse_info = exec_info->parse_info;
+	Command *cmd = exec_info->last_command;
+
+	if (cmd->array_assignment != ARRAY_ASSIGNMENT_OPEN) {
+		return error(line, exec_info);
+	}
+	if (parse_info->has_arg_started) {
+		new_argument(exec_info);
+		parse_info->copy = cmd->current_arg;
+	}
+	parse_info->has_arg_started = 0;
+	cmd->array_assignment = ARRAY_ASSIGNMENT_CLOSED;
+	return line;
+}
+
 char *
 end_pipe(char *line, ExecInfo * exec_info)
 {
@@ -1169,13 +2473,27 @@ copy_and_end_sub(char *line, ExecInfo * exec_info)
 	return ++line;
 }
 
+// $_ is special, but _ is also part of names like $my_var
+char *
+copy_or_end_sub(char *line, ExecInfo * exec_info)
+{
+	if (*exec_info->sub_info->buffer == '\0') {
+		return copy_and_end_sub(line, exec_info);
+	}
+	return copy(line, exec_info);
+}
+
 char *
 request_new_line(char *line, ExecInfo * exec_info)
 {
 	prompt_request();
-	fgets(line, MAX_ARGUMENT_SIZE, stdin);
-	if (ferror(stdin)) {
-		fprintf(stderr, "Error: fgets failed");
+	if (read_script_line(line, MAX_ARGUMENT_SIZE) == NULL) {
+		if (ferror(stdin)) {
+			fprintf(stderr, "Error: fgets failed");
+		} else {
+			fprintf(stderr,
+				"Mash: Error: unexpected end of file in quotes\n");
+		}
 		return NULL;
 	}
 	exec_info->parse_info->has_arg_started = 0;
@@ -1290,21 +2608,3 @@ seekfile(char *line, char filetype)
 	}
 	return 0;
 }
-
-int
-seeksubexec(char *line)
-{
-	char *ptr;
-
-	for (ptr = line; *ptr != '\0'; ptr++) {
-		if (*ptr != ' ' && *ptr != '\n' && *ptr != '\t') {
-			if (*ptr == '|' || *ptr == ';' || *ptr == '&'
-			    || *ptr == '>' || *ptr == '<' || *ptr == '#') {
-				return 0;
-			} else {
-				return 1;
-			}
-		}
-	}
-	return 0;
-}
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <err.h>
+#include "buffer.h"
 #include "builtin/command.h"
 #include "builtin/builtin.h"
 #include "builtin/export.h"
@@ -32,16 +33,19 @@
 #include "exec_cmd.h"
 #include "builtin/jobs.h"
 #include "exec_pipe.h"
+#include "mash.h"
+
+// DECLARE STATIC FUNCTIONS
+static void end_line_exec(ExecInfo * exec_info);
 
 int
-find_command(char *line, char *buffer, FILE * src_file,
+find_command(char *line, Buffer * buffer, FILE * src_file,
 	     ExecInfo * prev_exec_info, char *to_free_excess)
 {
 	int status = 0;
 	int status_for_next_cmd = DO_NOT_MATTER_TO_EXEC;
 	char *orig_line_ptr = line;
-	char cwd[MAX_ENV_SIZE];
-	char result[4];
+	int has_concurrent_subexecs;
 	ExecInfo *exec_info = new_exec_info(orig_line_ptr);
 
 	if (prev_exec_info != NULL) {
@@ -53,6 +57,7 @@ find_command(char *line, char *buffer, FILE * src_file,
 	}
 // ---------------------------------------------------------------
 
+	has_concurrent_subexecs = start_concurrent_subexecs(line);
 	while ((line = parse(line, exec_info))) {
 		switch (status_for_next_cmd) {
 		case DO_NOT_MATTER_TO_EXEC:
@@ -96,29 +101,58 @@ find_command(char *line, char *buffer, FILE * src_file,
 		}
 		status_for_next_cmd =
 		    exec_info->command->next_status_needed_to_exec;
-		sprintf(result, "%d", status);
-		add_env_by_name("result", result);
-		// Update cwd
-		if (getcwd(cwd, MAX_ENV_SIZE) == NULL) {
-			exit_mash(0, NULL, STDOUT_FILENO, STDERR_FILENO);
-			err(EXIT_FAILURE,
-			    "error getting current working directory");
+		last_status = status;
+		if (has_concurrent_subexecs) {
+			end_concurrent_subexecs();
 		}
-		add_env_by_name("PWD", cwd);
+		end_process_subs();
 		if (has_to_exit) {
 			break;
 		}
 		reset_exec_info(exec_info);
+		has_concurrent_subexecs = start_concurrent_subexecs(line);
+	}
+	if (has_concurrent_subexecs) {
+		end_concurrent_subexecs();
 	}
+	end_process_subs();
+
+	last_status = status;
+	end_line_exec(exec_info);
+	return status;
+}
 
-	sprintf(result, "%d", status);
-	add_env_by_name("result", result);
+int
+exec_words(char *line, char **words, int n_words, FILE * src_file)
+{
+	ExecInfo *exec_info = new_exec_info(line);
+	Command *cmd = exec_info->command;
+	int status;
+	int i;
 
+	for (i = 0; i < n_words; i++) {
+		strcpy(cmd->current_arg, words[i]);
+		add_arg(cmd);
+	}
+	if (use_job_control) {
+		status = launch_job(src_file, exec_info, NULL);
+	} else {
+		status = launch_pipe(src_file, exec_info, NULL);
+	}
+	end_process_subs();
+
+	last_status = status;
+	end_line_exec(exec_info);
+	return status;
+}
+
+static void
+end_line_exec(ExecInfo * exec_info)
+{
 	free(exec_info->parse_info);
 	free(exec_info->file_info);
 	free(exec_info->sub_info);
 	free_command(exec_info->command);
 	memset(exec_info->line, 0, MAX_ARGUMENT_SIZE);
 	free(exec_info);
-	return status;
 }
@@ -0,0 +1,365 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <err.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pattern.h"
+
+// DECLARE STATIC FUNCTIONS
+static Pattern *compile_pattern(const char *source);
+static void free_pattern(Pattern * pattern);
+static const char *compile_class(const char *source, PatternToken * token);
+static const char *add_named_class(const char *source, PatternToken * token);
+static int match_token(PatternToken * token, char c);
+static void skip_stars(Pattern * pattern, long *starts);
+
+// Replaced in order once it is full
+static Pattern *cache[PATTERN_CACHE_SIZE];
+static int next_cached = 0;
+
+// [:name:] inside a class
+static const struct {
+	const char *name;
+	int (*is_in_class)(int c);
+} named_classes[] = {
+	{ "alnum", isalnum }, { "alpha", isalpha }, { "blank", isblank },
+	{ "cntrl", iscntrl }, { "digit", isdigit }, { "graph", isgraph },
+	{ "lower", islower }, { "print", isprint }, { "punct", ispunct },
+	{ "space", isspace }, { "upper", isupper }, { "xdigit", isxdigit }
+};
+
+Pattern *
+get_pattern(const char *source)
+{
+	int i;
+
+	for (i = 0; i < PATTERN_CACHE_SIZE && cache[i] != NULL; i++) {
+		if (strcmp(cache[i]->source, source) == 0) {
+			return cache[i];
+		}
+	}
+
+	free_pattern(cache[next_cached]);
+	cache[next_cached] = compile_pattern(source);
+	i = next_cached;
+	next_cached = (next_cached + 1) % PATTERN_CACHE_SIZE;
+	return cache[i];
+}
+
+// * backtracks only to the last one seen, so it is linear for most patterns
+int
+match_pattern(Pattern * pattern, const char *str, size_t len)
+{
+	size_t token = 0;
+	size_t i = 0;
+	size_t star_token = 0;
+	size_t star_i = 0;
+	int has_star = 0;
+
+	if (!pattern->has_wildcards) {
+		return pattern->n_tokens == len
+		    && memcmp(pattern->literal, str, len) == 0;
+	}
+
+	while (i < len) {
+		if (token < pattern->n_tokens
+		    && pattern->tokens[token].type == PATTERN_ANY_STRING) {
+			has_star = 1;
+			star_token = token++;
+			star_i = i;
+		} else if (token < pattern->n_tokens
+			   && match_token(&pattern->tokens[token], str[i])) {
+			token++;
+			i++;
+		} else if (has_star) {
+			// The last * takes one more char
+			token = star_token + 1;
+			i = ++star_i;
+		} else {
+			return 0;
+		}
+	}
+	while (token < pattern->n_tokens
+	       && pattern->tokens[token].type == PATTERN_ANY_STRING) {
+		token++;
+	}
+	return token == pattern->n_tokens;
+}
+
+long
+match_affix(Pattern * pattern, const char *str, int from_end, int longest)
+{
+	size_t len = strlen(str);
+	size_t i;
+	size_t affix_len;
+
+	for (i = 0; i <= len; i++) {
+		affix_len = longest ? len - i : i;
+		if (match_pattern(pattern, from_end ? str + len - affix_len :
+				  str, affix_len)) {
+			return affix_len;
+		}
+	}
+	return -1;
+}
+
+const char *
+find_pattern(Pattern * pattern, const char *str, size_t *len)
+{
+	size_t n_tokens = pattern->n_tokens;
+	long *starts, *next, *tmp;
+	long best_start = -1;
+	long best_end = -1;
+	long start;
+	size_t i, token, to;
+
+	if (!pattern->has_wildcards) {
+		*len = n_tokens;
+		return n_tokens == 0 ? NULL : strstr(str, pattern->literal);
+	}
+
+	// For each token, the first char of the earliest match that reached
+	// it. A later one could only end the same way, so str is read once
+	starts = malloc((n_tokens + 1) * sizeof(long));
+	next = malloc((n_tokens + 1) * sizeof(long));
+	if (starts == NULL || next == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	for (token = 0; token <= n_tokens; token++) {
+		starts[token] = -1;
+	}
+	for (i = 0;; i++) {
+		// A match may start at any char until one was found
+		if (best_start < 0 && starts[0] < 0) {
+			starts[0] = i;
+		}
+		skip_stars(pattern, starts);
+		start = starts[n_tokens];
+		if (start >= 0 && start < (long)i
+		    && (best_start < 0 || start < best_start
+			|| (start == best_start && (long)i > best_end))) {
+			best_start = start;
+			best_end = i;
+		}
+		if (str[i] == '\0') {
+			break;
+		}
+
+		for (token = 0; token <= n_tokens; token++) {
+			next[token] = -1;
+		}
+		for (token = 0; token < n_tokens; token++) {
+			start = starts[token];
+			if (start < 0 || (best_start >= 0 && start > best_start)) {
+				continue;
+			}
+			if (pattern->tokens[token].type == PATTERN_ANY_STRING) {
+				to = token;
+			} else if (match_token(&pattern->tokens[token], str[i])) {
+				to = token + 1;
+			} else {
+				continue;
+			}
+			if (next[to] < 0 || start < next[to]) {
+				next[to] = start;
+			}
+		}
+		tmp = starts;
+		starts = next;
+		next = tmp;
+	}
+	free(starts);
+	free(next);
+
+	if (best_start < 0) {
+		return NULL;
+	}
+	*len = best_end - best_start;
+	return str + best_start;
+}
+
+// A * can also match nothing, so the token after it is reached too
+static void
+skip_stars(Pattern * pattern, long *starts)
+{
+	size_t token;
+
+	for (token = 0; token < pattern->n_tokens; token++) {
+		if (starts[token] >= 0
+		    && pattern->tokens[token].type == PATTERN_ANY_STRING
+		    && (starts[token + 1] < 0
+			|| starts[token] < starts[token + 1])) {
+			starts[token + 1] = starts[token];
+		}
+	}
+}
+
+static Pattern *
+compile_pattern(const char *source)
+{
+	Pattern *pattern = malloc(sizeof(Pattern));
+	PatternToken *token;
+	const char *ptr;
+	const char *class_end;
+
+	if (pattern == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	// There are never more tokens than chars
+	pattern->tokens = malloc((strlen(source) + 1) * sizeof(PatternToken));
+	pattern->source = strdup(source);
+	pattern->literal = malloc(strlen(source) + 1);
+	if (pattern->tokens == NULL || pattern->source == NULL
+	    || pattern->literal == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	pattern->n_tokens = 0;
+	pattern->has_wildcards = 0;
+
+	for (ptr = source; *ptr != '\0'; ptr++) {
+		token = &pattern->tokens[pattern->n_tokens];
+		token->type = PATTERN_CHAR;
+		switch (*ptr) {
+		case '?':
+			token->type = PATTERN_ANY_CHAR;
+			break;
+		case '*':
+			token->type = PATTERN_ANY_STRING;
+			break;
+		case '[':
+			class_end = compile_class(ptr + 1, token);
+			if (class_end != NULL) {
+				token->type = PATTERN_CLASS;
+				ptr = class_end;
+			}
+			break;
+		case '\\':
+			if (ptr[1] != '\0') {
+				ptr++;
+			}
+			break;
+		}
+		if (token->type != PATTERN_CHAR) {
+			pattern->has_wildcards = 1;
+		}
+		token->c = *ptr;
+		pattern->literal[pattern->n_tokens++] = *ptr;
+	}
+	pattern->literal[pattern->n_tokens] = '\0';
+
+	return pattern;
+}
+
+static void
+free_pattern(Pattern * pattern)
+{
+	if (pattern == NULL) {
+		return;
+	}
+	free(pattern->source);
+	free(pattern->tokens);
+	free(pattern->literal);
+	free(pattern);
+}
+
+// source is after the [, returns the ] that ends the class or NULL if it
+// is not a class
+static const char *
+compile_class(const char *source, PatternToken * token)
+{
+	const char *ptr = source;
+	const char *class_end;
+	int negate = 0;
+	int c;
+	int i;
+
+	memset(token->set, 0, sizeof(token->set));
+	if (*ptr == '!' || *ptr == '^') {
+		negate = 1;
+		ptr++;
+	}
+	if (*ptr == '\0') {
+		return NULL;
+	}
+	// A ] right after [ or [! is part of the class
+	do {
+		if (ptr[0] == '[' && ptr[1] == ':'
+		    && (class_end = add_named_class(ptr + 2, token)) != NULL) {
+			ptr = class_end;
+		} else if (ptr[1] == '-' && ptr[2] != ']' && ptr[2] != '\0') {
+			for (c = (unsigned char)ptr[0];
+			     c <= (unsigned char)ptr[2]; c++) {
+				token->set[c / 8] |= 1 << (c % 8);
+			}
+			ptr += 3;
+		} else {
+			c = (unsigned char)*ptr++;
+			token->set[c / 8] |= 1 << (c % 8);
+		}
+	} while (*ptr != ']' && *ptr != '\0');
+	if (*ptr != ']') {
+		return NULL;
+	}
+
+	if (negate) {
+		for (i = 0; i < (int)sizeof(token->set); i++) {
+			token->set[i] = ~token->set[i];
+		}
+	}
+	return ptr;
+}
+
+// source is after the [:, returns what follows the :] or NULL if it is not
+// a named class. An unknown name matches nothing, like in bash
+static const char *
+add_named_class(const char *source, PatternToken * token)
+{
+	const char *end;
+	size_t i;
+	int c;
+
+	for (end = source; islower((unsigned char)*end); end++) ;
+	if (end[0] != ':' || end[1] != ']') {
+		return NULL;
+	}
+	for (i = 0; i < sizeof(named_classes) / sizeof(named_classes[0]); i++) {
+		if (strlen(named_classes[i].name) == (size_t)(end - source)
+		    && strncmp(named_classes[i].name, source,
+			       end - source) == 0) {
+			for (c = 0; c < 256; c++) {
+				if (named_classes[i].is_in_class(c)) {
+					token->set[c / 8] |= 1 << (c % 8);
+				}
+			}
+			break;
+		}
+	}
+	return end + 2;
+}
+
+static int
+match_token(PatternToken * token, char c)
+{
+	unsigned char byte = c;
+
+	switch (token->type) {
+	case PATTERN_ANY_CHAR:
+		return 1;
+	case PATTERN_CLASS:
+		return (token->set[byte / 8] >> (byte % 8)) & 1;
+	}
+	return token->c == c;
+}
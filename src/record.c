@@ -0,0 +1,84 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+#include "buffer.h"
+#include "record.h"
+
+void
+put_bytes(Buffer * buffer, const void *data, size_t len)
+{
+	if (append_buffer(buffer, data, len) < 0) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+}
+
+void
+put_u32(Buffer * buffer, uint32_t value)
+{
+	put_bytes(buffer, &value, sizeof(value));
+}
+
+void
+put_u64(Buffer * buffer, uint64_t value)
+{
+	put_bytes(buffer, &value, sizeof(value));
+}
+
+void
+put_string(Buffer * buffer, const char *str, size_t len)
+{
+	put_u32(buffer, len);
+	put_bytes(buffer, str, len + 1);
+}
+
+int
+get_u32(const char **ptr, const char *end, uint32_t * value)
+{
+	if (end - *ptr < (long)sizeof(*value)) {
+		return 0;
+	}
+	memcpy(value, *ptr, sizeof(*value));
+	*ptr += sizeof(*value);
+	return 1;
+}
+
+int
+get_u64(const char **ptr, const char *end, uint64_t * value)
+{
+	if (end - *ptr < (long)sizeof(*value)) {
+		return 0;
+	}
+	memcpy(value, *ptr, sizeof(*value));
+	*ptr += sizeof(*value);
+	return 1;
+}
+
+// Returns NULL if the string is not complete or not '\0' terminated
+const char *
+get_string(const char **ptr, const char *end, uint32_t len)
+{
+	const char *str = *ptr;
+
+	if ((size_t)(end - *ptr) < (size_t)len + 1 || str[len] != '\0') {
+		return NULL;
+	}
+	*ptr += len + 1;
+	return str;
+}
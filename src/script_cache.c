@@ -0,0 +1,331 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+#include "buffer.h"
+#include "record.h"
+#include "variables.h"
+#include "builtin/command.h"
+#include "mash.h"
+#include "script_cache.h"
+
+// DECLARE STATIC FUNCTIONS
+static char *cache_path(const struct stat *st);
+static void put_stat(Buffer * buffer, const struct stat *st);
+static int is_same_script(const char **ptr, const char *end,
+			  const struct stat *st);
+static void compile_line(Buffer * buffer, const char *text, size_t len);
+static int get_kind(const char *text, size_t len);
+static void put_text(Buffer * buffer, const char *text, size_t len);
+static void save_compiled_script(CompiledScript * script,
+				 const struct stat *st);
+
+// DECLARE GLOBAL VARIABLE
+char *script_cache_dir = NULL;
+
+static const char script_cache_magic[SCRIPT_CACHE_MAGIC_SIZE] = "MASHSCC1";
+static const char *script_cache_suffix = ".msc";
+
+// Characters of a line that need the lexer, in any syntax
+static const char *special_chars = "\"#$&'()*;<>?[\\{}|~";
+
+int
+load_compiled_script(CompiledScript * script, const struct stat *st)
+{
+	struct stat cache_st;
+	ScriptLine line;
+	const char *data, *ptr, *end;
+	char *path = cache_path(st);
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	free(path);
+	if (fd < 0) {
+		return 0;
+	}
+	if (fstat(fd, &cache_st) < 0
+	    || cache_st.st_size < SCRIPT_CACHE_MAGIC_SIZE) {
+		close(fd);
+		return 0;
+	}
+	data = mmap(NULL, cache_st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return 0;
+	}
+	ptr = data;
+	end = data + cache_st.st_size;
+	if (!is_same_script(&ptr, end, st)) {
+		munmap((void *)data, cache_st.st_size);
+		return 0;
+	}
+
+	// Every record is checked before running any line
+	script->lines = ptr;
+	while (next_script_line(&ptr, end, &line)) ;
+	if (ptr != end) {
+		munmap((void *)data, cache_st.st_size);
+		return 0;
+	}
+	script->end = end;
+	script->map = (void *)data;
+	script->map_size = cache_st.st_size;
+	script->buffer = NULL;
+	return 1;
+}
+
+static int
+is_same_script(const char **ptr, const char *end, const struct stat *st)
+{
+	uint32_t len;
+	uint64_t dev, ino, size, sec, nsec;
+	const char *vers;
+
+	if (memcmp(*ptr, script_cache_magic, SCRIPT_CACHE_MAGIC_SIZE) != 0) {
+		return 0;
+	}
+	*ptr += SCRIPT_CACHE_MAGIC_SIZE;
+	return get_u32(ptr, end, &len)
+	    && (vers = get_string(ptr, end, len)) != NULL
+	    && strcmp(vers, version) == 0
+	    && get_u64(ptr, end, &dev) && get_u64(ptr, end, &ino)
+	    && get_u64(ptr, end, &size) && get_u64(ptr, end, &sec)
+	    && get_u64(ptr, end, &nsec)
+	    && (uint64_t) st->st_dev == dev && (uint64_t) st->st_ino == ino
+	    && (uint64_t) st->st_size == size
+	    && (uint64_t) st->st_mtim.tv_sec == sec
+	    && (uint64_t) st->st_mtim.tv_nsec == nsec;
+}
+
+void
+compile_script(CompiledScript * script, const struct stat *st,
+	       const char *data, size_t size)
+{
+	Buffer *buffer = new_buffer();
+	const char *end = data + size;
+	const char *eol;
+	size_t header, len;
+
+	put_bytes(buffer, script_cache_magic, SCRIPT_CACHE_MAGIC_SIZE);
+	put_string(buffer, version, strlen(version));
+	put_stat(buffer, st);
+	header = buffer->len;
+
+	for (; data < end; data += len) {
+		// The same lines read_script_line would return
+		eol = memchr(data, '\n', end - data);
+		len = eol == NULL ? (size_t)(end - data) : (size_t)(eol - data + 1);
+		if (len > MAX_ARGUMENT_SIZE - 1) {
+			len = MAX_ARGUMENT_SIZE - 1;
+		}
+		compile_line(buffer, data, len);
+	}
+
+	script->buffer = buffer;
+	script->map = NULL;
+	script->map_size = 0;
+	script->lines = buffer->data + header;
+	script->end = buffer->data + buffer->len;
+	save_compiled_script(script, st);
+}
+
+static void
+compile_line(Buffer * buffer, const char *text, size_t len)
+{
+	const char *ptr, *end = text + len;
+	const char *word;
+	size_t n_words_pos;
+	uint32_t n_words = 0;
+	int kind = get_kind(text, len);
+
+	put_u32(buffer, kind);
+	put_text(buffer, text, len);
+	n_words_pos = buffer->len;
+	put_u32(buffer, 0);
+	if (kind != SCRIPT_WORDS) {
+		return;
+	}
+	for (ptr = text; ptr < end;) {
+		for (; ptr < end && (*ptr == ' ' || *ptr == '\t'
+				     || *ptr == '\n'); ptr++) ;
+		for (word = ptr; ptr < end && *ptr != ' ' && *ptr != '\t'
+		     && *ptr != '\n'; ptr++) ;
+		if (ptr > word) {
+			put_text(buffer, word, ptr - word);
+			n_words++;
+		}
+	}
+	memcpy(buffer->data + n_words_pos, &n_words, sizeof(uint32_t));
+}
+
+static int
+get_kind(const char *text, size_t len)
+{
+	const char *ptr, *end = text + len;
+	int n_words = 0;
+	int in_word = 0;
+
+	for (ptr = text; ptr < end && (*ptr == ' ' || *ptr == '\t'); ptr++) ;
+	if (ptr == end || *ptr == '\n') {
+		return SCRIPT_BLANK;
+	}
+	if (*ptr == '#') {
+		return SCRIPT_COMMENT;
+	}
+	// A line cut by the length limit goes on in the next one
+	if (text[len - 1] != '\n' && len == MAX_ARGUMENT_SIZE - 1) {
+		return SCRIPT_TEXT;
+	}
+	for (; ptr < end; ptr++) {
+		if (*ptr == ' ' || *ptr == '\t' || *ptr == '\n') {
+			in_word = 0;
+		} else if (*ptr == '\0' || strchr(special_chars, *ptr) != NULL) {
+			return SCRIPT_TEXT;
+		} else if (!in_word) {
+			in_word = 1;
+			n_words++;
+		}
+	}
+	return n_words < MAX_ARGUMENTS - 1 ? SCRIPT_WORDS : SCRIPT_TEXT;
+}
+
+int
+next_script_line(const char **ptr, const char *end, ScriptLine * line)
+{
+	uint32_t kind, len, n_words, i;
+
+	if (!get_u32(ptr, end, &kind) || kind > SCRIPT_TEXT
+	    || !get_u32(ptr, end, &line->len)
+	    || (line->text = get_string(ptr, end, line->len)) == NULL
+	    || !get_u32(ptr, end, &n_words) || n_words >= MAX_ARGUMENTS
+	    || (kind == SCRIPT_WORDS && n_words == 0)) {
+		return 0;
+	}
+	line->kind = kind;
+	line->n_words = n_words;
+	for (i = 0; i < n_words; i++) {
+		if (!get_u32(ptr, end, &len)
+		    || (line->words[i] = (char *)get_string(ptr, end, len))
+		    == NULL) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void
+free_compiled_script(CompiledScript * script)
+{
+	if (script->map != NULL) {
+		munmap(script->map, script->map_size);
+	} else {
+		free_buffer(script->buffer);
+	}
+}
+
+int
+clear_script_cache()
+{
+	DIR *dir = opendir(script_cache_dir);
+	struct dirent *entry;
+	size_t len, suffix_len = strlen(script_cache_suffix);
+	int n_removed = 0;
+
+	if (dir == NULL) {
+		return -1;
+	}
+	while ((entry = readdir(dir)) != NULL) {
+		len = strlen(entry->d_name);
+		if (len > suffix_len && strcmp(entry->d_name + len - suffix_len,
+					       script_cache_suffix) == 0
+		    && unlinkat(dirfd(dir), entry->d_name, 0) == 0) {
+			n_removed++;
+		}
+	}
+	closedir(dir);
+	return n_removed;
+}
+
+// Other mash may be loading it, the new one replaces it at once
+static void
+save_compiled_script(CompiledScript * script, const struct stat *st)
+{
+	char *path = cache_path(st);
+	char *tmp_path = malloc(strlen(path) + MAX_INTEGER_STRING + 2);
+	Buffer *buffer = script->buffer;
+	int fd;
+
+	if (tmp_path == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	sprintf(tmp_path, "%s.%d", path, getpid());
+	fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	// Like the snapshot, a cache that cannot be written, such as a read
+	// only one, is not an error: the script just runs from its text
+	if (fd >= 0 && (write(fd, buffer->data, buffer->len) !=
+			(ssize_t) buffer->len || rename(tmp_path, path) < 0)) {
+		unlink(tmp_path);
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+	free(tmp_path);
+	free(path);
+}
+
+// A script is found by its device and inode, so every path to it shares
+// the compiled script
+static char *
+cache_path(const struct stat *st)
+{
+	char *path = malloc(strlen(script_cache_dir) +
+			    MAX_INTEGER_STRING * 2 + 8);
+
+	if (path == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	sprintf(path, "%s/%llx-%llx%s", script_cache_dir,
+		(unsigned long long)st->st_dev, (unsigned long long)st->st_ino,
+		script_cache_suffix);
+	return path;
+}
+
+// Like put_string, for text of the script that is not '\0' terminated
+static void
+put_text(Buffer * buffer, const char *text, size_t len)
+{
+	put_u32(buffer, len);
+	put_bytes(buffer, text, len);
+	put_bytes(buffer, "", 1);
+}
+
+static void
+put_stat(Buffer * buffer, const struct stat *st)
+{
+	put_u64(buffer, st->st_dev);
+	put_u64(buffer, st->st_ino);
+	put_u64(buffer, st->st_size);
+	put_u64(buffer, st->st_mtim.tv_sec);
+	put_u64(buffer, st->st_mtim.tv_nsec);
+}
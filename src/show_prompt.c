@@ -20,6 +20,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <err.h>
+#include "variables.h"
+#include "buffer.h"
 #include "builtin/command.h"
 #include "builtin/export.h"
 #include "builtin/alias.h"
@@ -41,8 +43,9 @@ set_prompt_mode(int mode)
 int
 prompt(char *line)
 {
-	char *result = getenv("result");
-	char *prompt = getenv("PROMPT");
+	char *prompt = get_var("PROMPT");
+	// The commands of the prompt must not change $?
+	int status = last_status;
 
 	if (shell_mode == INTERACTIVE_MODE) {
 		if (syntax_mode == BASIC_SYNTAX) {
@@ -62,7 +65,7 @@ prompt(char *line)
 		fflush(stdout);
 	}
 
-	add_env_by_name("result", result);
+	last_status = status;
 	return 1;
 }
 
@@ -116,11 +119,7 @@ parse_prompt(char *prompt, char *line)
 			match = 1;
 		} else if (strstr(token, "ifgit") == token) {
 			fflush(stdout);
-			char *buffer = malloc(1024);
-
-			if (buffer == NULL)
-				err(EXIT_FAILURE, "malloc failed");
-			memset(buffer, 0, 1024);
+			Buffer *buffer = new_buffer();
 
 			strcpy(line, "git branch 2> /dev/null");
 
@@ -143,7 +142,7 @@ parse_prompt(char *prompt, char *line)
 					}
 				}
 			}
-			free(buffer);
+			free_buffer(buffer);
 			match = 1;
 		} else if (strstr(token, "else") == token) {
 			while ((token = strtok_r(rest, "@", &rest))) {
@@ -172,11 +171,7 @@ parse_prompt(char *prompt, char *line)
 			if (writing_to_file) {
 				printf("%s", token);
 			} else {
-				char *buffer = malloc(1024);
-
-				if (buffer == NULL)
-					err(EXIT_FAILURE, "malloc failed");
-				memset(buffer, 0, 1024);
+				Buffer *buffer = new_buffer();
 
 				strcpy(line,
 				       "git status --porcelain 2> /dev/null | wc -l");
@@ -184,23 +179,19 @@ parse_prompt(char *prompt, char *line)
 				find_command(line, buffer, stdin, NULL,
 					     rest_start);
 
-				strtok(buffer, "\n");
-				if (atoi(buffer) > 0) {
+				chomp_buffer(buffer);
+				if (atoi(buffer->data) > 0) {
 					printf("\033[01;31m%s", token);
 				} else {
 					printf("\033[01;32m%s", token);
 				}
 
-				free(buffer);
+				free_buffer(buffer);
 			}
 			match = 1;
 		} else if (strstr(token, "gitstatus") == token) {
 			fflush(stdout);
-			char *buffer = malloc(1024);
-
-			if (buffer == NULL)
-				err(EXIT_FAILURE, "malloc failed");
-			memset(buffer, 0, 1024);
+			Buffer *buffer = new_buffer();
 
 			strcpy(line,
 			       "git status --porcelain 2> /dev/null | wc -l");
@@ -208,14 +199,14 @@ parse_prompt(char *prompt, char *line)
 			token += strlen("gitstatus");
 			find_command(line, buffer, stdin, NULL, rest_start);
 
-			strtok(buffer, "\n");
-			if (atoi(buffer) > 0) {
-				printf("|%s%s", buffer, token);
+			chomp_buffer(buffer);
+			if (atoi(buffer->data) > 0) {
+				printf("|%s%s", buffer->data, token);
 			} else {
 				printf("%s", token);
 			}
 
-			free(buffer);
+			free_buffer(buffer);
 			match = 1;
 		} else if (strstr(token, "black") == token) {
 			token += strlen("black");
@@ -291,11 +282,7 @@ parse_prompt(char *prompt, char *line)
 			match = 1;
 		} else if (strstr(token, "branch") == token) {
 			fflush(stdout);
-			char *buffer = malloc(1024);
-
-			if (buffer == NULL)
-				err(EXIT_FAILURE, "malloc failed");
-			memset(buffer, 0, 1024);
+			Buffer *buffer = new_buffer();
 
 			strcpy(line,
 			       "git branch 2> /dev/null | sed -e '/^[^*]/d' -e 's/* \\(.*\\)/\\1/'");
@@ -303,17 +290,17 @@ parse_prompt(char *prompt, char *line)
 			token += strlen("branch");
 			find_command(line, buffer, stdin, NULL, rest_start);
 
-			strtok(buffer, "\n");
-			if (strlen(buffer) > 0) {
-				printf("%s%s", buffer, token);
+			chomp_buffer(buffer);
+			if (buffer->len > 0) {
+				printf("%s%s", buffer->data, token);
 			} else {
 				printf("%s", token);
 			}
 
-			free(buffer);
+			free_buffer(buffer);
 			match = 1;
 		} else if (strstr(token, "where") == token) {
-			char *cwd = getenv("PWD");
+			char *cwd = get_var("PWD");
 
 			if (cwd == NULL) {
 				match = 1;
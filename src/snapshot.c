@@ -0,0 +1,282 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <err.h>
+#include "buffer.h"
+#include "record.h"
+#include "variables.h"
+#include "builtin/alias.h"
+#include "builtin/source.h"
+#include "mash.h"
+#include "snapshot.h"
+
+// DECLARE STATIC FUNCTIONS
+static int is_file_unchanged(const char **ptr, const char *end);
+static int restore_snapshot(const char *ptr, const char *end);
+static int is_environment_unchanged(const char **ptr, const char *end);
+static uint64_t hash_env_var(const char *name);
+
+static const char snapshot_magic[SNAPSHOT_MAGIC_SIZE] = "MASHSNP3";
+
+int
+load_snapshot(const char *path)
+{
+	struct stat st;
+	const char *data;
+	int loaded;
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+	if (fd < 0) {
+		return 0;
+	}
+	if (fstat(fd, &st) < 0 || st.st_size < SNAPSHOT_MAGIC_SIZE) {
+		close(fd);
+		return 0;
+	}
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return 0;
+	}
+	loaded = restore_snapshot(data, data + st.st_size);
+	munmap((void *)data, st.st_size);
+	return loaded;
+}
+
+// Nothing is restored until every file was checked
+static int
+restore_snapshot(const char *ptr, const char *end)
+{
+	uint32_t len, name_len, value_len, var_flags;
+	uint32_t n_files, n_aliases, n_vars;
+	const char *vers, *name, *value;
+	const char *records;
+	uint32_t i;
+
+	if (memcmp(ptr, snapshot_magic, SNAPSHOT_MAGIC_SIZE) != 0) {
+		return 0;
+	}
+	ptr += SNAPSHOT_MAGIC_SIZE;
+	if (!get_u32(&ptr, end, &len)
+	    || (vers = get_string(&ptr, end, len)) == NULL
+	    || strcmp(vers, version) != 0
+	    || !is_environment_unchanged(&ptr, end)
+	    || !get_u32(&ptr, end, &n_files) || !get_u32(&ptr, end, &n_aliases)
+	    || !get_u32(&ptr, end, &n_vars)) {
+		return 0;
+	}
+	for (i = 0; i < n_files; i++) {
+		if (!is_file_unchanged(&ptr, end)) {
+			return 0;
+		}
+	}
+
+	// Check the records before changing anything
+	records = ptr;
+	for (i = 0; i < n_aliases + n_vars; i++) {
+		if ((i >= n_aliases && !get_u32(&ptr, end, &var_flags))
+		    || !get_u32(&ptr, end, &name_len)
+		    || !get_u32(&ptr, end, &value_len)
+		    || get_string(&ptr, end, name_len) == NULL
+		    || get_string(&ptr, end, value_len) == NULL) {
+			return 0;
+		}
+	}
+
+	ptr = records;
+	for (i = 0; i < n_aliases; i++) {
+		get_u32(&ptr, end, &name_len);
+		get_u32(&ptr, end, &value_len);
+		name = get_string(&ptr, end, name_len);
+		value = get_string(&ptr, end, value_len);
+		set_alias(name, value);
+	}
+	for (i = 0; i < n_vars; i++) {
+		get_u32(&ptr, end, &var_flags);
+		get_u32(&ptr, end, &name_len);
+		get_u32(&ptr, end, &value_len);
+		name = get_string(&ptr, end, name_len);
+		value = get_string(&ptr, end, value_len);
+		set_var(name, value, var_flags);
+	}
+	return 1;
+}
+
+// The rc may compute values from the environment, like PATH=$PATH:dir,
+// so only the inherited variables it used must keep their values
+static int
+is_environment_unchanged(const char **ptr, const char *end)
+{
+	uint32_t n_names, len;
+	uint64_t env_hash;
+	uint64_t sum = 0;
+	const char *name;
+	uint32_t i;
+
+	if (!get_u32(ptr, end, &n_names)) {
+		return 0;
+	}
+	for (i = 0; i < n_names; i++) {
+		if (!get_u32(ptr, end, &len)
+		    || (name = get_string(ptr, end, len)) == NULL) {
+			return 0;
+		}
+		sum += hash_env_var(name);
+	}
+	return get_u64(ptr, end, &env_hash) && env_hash == sum;
+}
+
+static int
+is_file_unchanged(const char **ptr, const char *end)
+{
+	struct stat st;
+	uint32_t len;
+	uint64_t dev, ino, size, sec, nsec;
+	const char *path;
+
+	if (!get_u32(ptr, end, &len)
+	    || (path = get_string(ptr, end, len)) == NULL
+	    || !get_u64(ptr, end, &dev) || !get_u64(ptr, end, &ino)
+	    || !get_u64(ptr, end, &size) || !get_u64(ptr, end, &sec)
+	    || !get_u64(ptr, end, &nsec)) {
+		return 0;
+	}
+	return stat(path, &st) == 0 && (uint64_t) st.st_dev == dev
+	    && (uint64_t) st.st_ino == ino && (uint64_t) st.st_size == size
+	    && (uint64_t) st.st_mtim.tv_sec == sec
+	    && (uint64_t) st.st_mtim.tv_nsec == nsec;
+}
+
+int
+save_snapshot(const char *path)
+{
+	Buffer *buffer = new_buffer();
+	struct stat st;
+	struct alias *alias;
+	const char *file, *name, *value, *env_value;
+	char *tmp_path;
+	uint32_t n_names = 0, n_files = 0, n_aliases = 0, n_vars = 0;
+	uint64_t env_hash = 0;
+	size_t counts, index;
+	int var_flags;
+	int fd;
+	int status = 0;
+
+	put_bytes(buffer, snapshot_magic, SNAPSHOT_MAGIC_SIZE);
+	put_string(buffer, version, strlen(version));
+	counts = buffer->len;
+	put_u32(buffer, 0);
+	for (index = 0; (name = next_tracked_name(&index)) != NULL; n_names++) {
+		put_string(buffer, name, strlen(name));
+		env_hash += hash_env_var(name);
+	}
+	memcpy(buffer->data + counts, &n_names, sizeof(uint32_t));
+	put_u64(buffer, env_hash);
+	// The counts are known at the end
+	counts = buffer->len;
+	put_u32(buffer, 0);
+	put_u32(buffer, 0);
+	put_u32(buffer, 0);
+
+	for (index = 0; (file = next_sourced_path(&index)) != NULL;) {
+		if (stat(file, &st) < 0) {
+			free_buffer(buffer);
+			return -1;
+		}
+		put_string(buffer, file, strlen(file));
+		put_u64(buffer, st.st_dev);
+		put_u64(buffer, st.st_ino);
+		put_u64(buffer, st.st_size);
+		put_u64(buffer, st.st_mtim.tv_sec);
+		put_u64(buffer, st.st_mtim.tv_nsec);
+		n_files++;
+	}
+	for (index = 0; (alias = next_alias(&index)) != NULL; n_aliases++) {
+		put_u32(buffer, strlen(alias->command));
+		put_u32(buffer, strlen(alias->reference));
+		put_bytes(buffer, alias->command, strlen(alias->command) + 1);
+		put_bytes(buffer, alias->reference,
+			  strlen(alias->reference) + 1);
+	}
+	for (index = 0; next_var(&index, &name, &value, &var_flags);) {
+		// The rest come from the environment of this mash
+		env_value = getenv(name);
+		if (var_flags == VAR_EXPORTED && env_value != NULL
+		    && strcmp(env_value, value) == 0) {
+			continue;
+		}
+		put_u32(buffer, var_flags);
+		put_u32(buffer, strlen(name));
+		put_u32(buffer, strlen(value));
+		put_bytes(buffer, name, strlen(name) + 1);
+		put_bytes(buffer, value, strlen(value) + 1);
+		n_vars++;
+	}
+	memcpy(buffer->data + counts, &n_files, sizeof(uint32_t));
+	memcpy(buffer->data + counts + 4, &n_aliases, sizeof(uint32_t));
+	memcpy(buffer->data + counts + 8, &n_vars, sizeof(uint32_t));
+
+	// Other mash may be loading it, the new one replaces it at once
+	tmp_path = malloc(strlen(path) + MAX_INTEGER_STRING + 2);
+	if (tmp_path == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	sprintf(tmp_path, "%s.%d", path, getpid());
+	fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0 || write(fd, buffer->data, buffer->len) !=
+	    (ssize_t) buffer->len || rename(tmp_path, path) < 0) {
+		unlink(tmp_path);
+		status = -1;
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+	free(tmp_path);
+	free_buffer(buffer);
+	return status;
+}
+
+// FNV-1a of name=value as mash inherited it, only the name if it was unset.
+// The hashes are added, so the order of the names does not matter.
+static uint64_t
+hash_env_var(const char *name)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	const char *value = getenv(name);
+	const char *c;
+
+	for (c = name; *c != '\0'; c++) {
+		hash ^= (unsigned char)*c;
+		hash *= 1099511628211ULL;
+	}
+	if (value == NULL) {
+		return hash;
+	}
+	hash ^= '=';
+	hash *= 1099511628211ULL;
+	for (c = value; *c != '\0'; c++) {
+		hash ^= (unsigned char)*c;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
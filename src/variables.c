@@ -0,0 +1,771 @@
+// Copyright 2023 Javier Izquierdo Hernández
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <unistd.h>
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "variables.h"
+#include "builtin/mash_math.h"
+
+// DECLARE STATIC FUNCTIONS
+static unsigned int hash_name(const char *name, size_t len);
+static Variable *find_slot(Variable * table, size_t size, const char *name,
+			   size_t len, unsigned int hash);
+static void grow_variables();
+static int is_valid_name(const char *name, size_t len);
+static Variable *lookup_var(const char *name);
+static Variable *insert_var(const char *name, size_t len);
+static char *var_value(Variable * variable);
+static void add_var_flags(Variable * variable, int flags);
+static int set_var_len(const char *name, size_t len, const char *value,
+		       int flags);
+static int set_var_int_len(const char *name, size_t len, long long value,
+			   int flags);
+static Array *to_array(Variable * variable);
+static void grow_array(Array * array, size_t size);
+static void free_element(Array * array, char *element);
+static void clear_array(Array * array);
+static void set_element(Array * array, size_t index, const char *value);
+static int assign_element(const char *name, size_t len, const char *index,
+			  size_t index_len, const char *value);
+static void track_var(Variable * variable);
+static void track_name(const char *name);
+
+// Open addressing with linear probing, variables are never removed
+static Variable *variables = NULL;
+static size_t variables_size = 0;
+static size_t n_variables = 0;
+
+unsigned long env_generation = 0;
+unsigned long envp_rebuilds = 0;
+unsigned long envp_reuses = 0;
+
+static char **envp = NULL;
+static char *envp_strings = NULL;
+static unsigned long envp_generation = (unsigned long)-1;
+
+// Names recorded by track_environment
+static int tracking = 0;
+static char **tracked_names = NULL;
+static size_t n_tracked_names = 0;
+static size_t tracked_names_size = 0;
+
+void
+init_variables(char **init_envp)
+{
+	char *eq;
+
+	variables = calloc(VARIABLES_INITIAL_SIZE, sizeof(Variable));
+	if (variables == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	variables_size = VARIABLES_INITIAL_SIZE;
+	n_variables = 0;
+
+	for (; init_envp != NULL && *init_envp != NULL; init_envp++) {
+		eq = strchr(*init_envp, '=');
+		if (eq != NULL) {
+			set_var_len(*init_envp, eq - *init_envp, eq + 1,
+				    VAR_EXPORTED | VAR_INHERITED);
+		}
+	}
+}
+
+char *
+get_var(const char *name)
+{
+	Variable *variable = lookup_var(name);
+
+	return variable == NULL ? NULL : var_value(variable);
+}
+
+int
+get_var_int(const char *name, long long *value)
+{
+	Variable *variable = lookup_var(name);
+	char *end;
+
+	if (variable == NULL) {
+		return -1;
+	}
+	if (variable->flags & VAR_INTEGER) {
+		*value = variable->integer;
+		return 0;
+	}
+	*value = strtoll(var_value(variable), &end, 10);
+	if (end == var_value(variable) || *end != '\0') {
+		return -1;
+	}
+	return 0;
+}
+
+int
+set_var(const char *name, const char *value, int flags)
+{
+	return set_var_len(name, strlen(name), value, flags);
+}
+
+int
+set_var_int(const char *name, long long value, int flags)
+{
+	return set_var_int_len(name, strlen(name), value, flags);
+}
+
+int
+assign_var(const char *assignment, int flags)
+{
+	char *eq = strchr(assignment, '=');
+	char *bracket;
+
+	if (eq == NULL) {
+		return -1;
+	}
+	bracket = memchr(assignment, '[', eq - assignment);
+	if (bracket != NULL) {
+		if (eq[-1] != ']') {
+			return -1;
+		}
+		return assign_element(assignment, bracket - assignment,
+				      bracket + 1, eq - 1 - (bracket + 1),
+				      eq + 1);
+	}
+	return set_var_len(assignment, eq - assignment, eq + 1, flags);
+}
+
+int
+set_var_flags(const char *name, int flags)
+{
+	Variable *variable;
+
+	if (!is_valid_name(name, strlen(name))) {
+		return -1;
+	}
+	variable = lookup_var(name);
+	if (variable == NULL) {
+		return -2;
+	}
+	if (flags & VAR_ARRAY) {
+		to_array(variable);
+	}
+	if (variable->array != NULL) {
+		flags &= ~VAR_INTEGER;
+	} else if (flags & VAR_INTEGER && !(variable->flags & VAR_INTEGER)) {
+		// The current value is the first expression
+		return set_var(name, variable->value, flags);
+	}
+	add_var_flags(variable, flags);
+	return 0;
+}
+
+int
+set_array(const char *name, char *const *values, size_t n)
+{
+	size_t len = strlen(name);
+	Array *array;
+	size_t i;
+
+	if (!is_valid_name(name, len)) {
+		return -1;
+	}
+
+	array = to_array(insert_var(name, len));
+	clear_array(array);
+	grow_array(array, n);
+	for (i = 0; i < n; i++) {
+		set_element(array, i, values[i]);
+	}
+	return 0;
+}
+
+int
+set_array_element(const char *name, size_t index, const char *value)
+{
+	size_t len = strlen(name);
+
+	if (!is_valid_name(name, len)) {
+		return -1;
+	}
+
+	set_element(to_array(insert_var(name, len)), index, value);
+	return 0;
+}
+
+int
+load_array(const char *name, char *block, size_t block_size,
+	   char **elements, size_t n)
+{
+	size_t len = strlen(name);
+	Array *array;
+
+	if (!is_valid_name(name, len)) {
+		return -1;
+	}
+
+	array = to_array(insert_var(name, len));
+	clear_array(array);
+	free(array->elements);
+	array->elements = elements;
+	array->len = n;
+	array->size = n;
+	array->n_set = n;
+	array->block = block;
+	array->block_size = block_size;
+	return 0;
+}
+
+char *const *
+get_array(const char *name, size_t *len)
+{
+	static char *scalar[1];
+	Variable *variable = lookup_var(name);
+
+	if (variable == NULL) {
+		return NULL;
+	}
+	if (variable->array == NULL) {
+		scalar[0] = var_value(variable);
+		*len = 1;
+		return scalar;
+	}
+	*len = variable->array->len;
+	return variable->array->elements;
+}
+
+long
+count_array(const char *name)
+{
+	Variable *variable = lookup_var(name);
+
+	if (variable == NULL) {
+		return -1;
+	}
+	return variable->array == NULL ? 1 : (long)variable->array->n_set;
+}
+
+int
+eval_array_index(const char *name, char *expression, size_t *index)
+{
+	Variable *variable = lookup_var(name);
+	long long value;
+
+	if (eval_math(expression, &value, STDERR_FILENO) < 0) {
+		return -1;
+	}
+	if (value < 0 && variable != NULL && variable->array != NULL) {
+		value += variable->array->len;
+	} else if (value < 0 && variable != NULL) {
+		value++;
+	}
+	if (value < 0) {
+		fprintf(stderr, "mash: %s[%s]: bad array subscript\n", name,
+			expression);
+		return -1;
+	}
+	*index = value;
+	return 0;
+}
+
+char **
+get_envp()
+{
+	size_t i;
+	size_t n_exported = 0;
+	size_t strings_len = 0;
+	char *ptr;
+
+	if (envp != NULL && envp_generation == env_generation) {
+		envp_reuses++;
+		return envp;
+	}
+	envp_rebuilds++;
+
+	for (i = 0; i < variables_size; i++) {
+		if (variables[i].name != NULL
+		    && variables[i].flags & VAR_EXPORTED
+		    && variables[i].array == NULL) {
+			n_exported++;
+			strings_len += strlen(variables[i].name) +
+			    strlen(var_value(&variables[i])) + 2;
+		}
+	}
+
+	free(envp);
+	free(envp_strings);
+	envp = malloc((n_exported + 1) * sizeof(char *));
+	envp_strings = malloc(strings_len + 1);
+	if (envp == NULL || envp_strings == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+
+	// Every name=value is in a single block
+	ptr = envp_strings;
+	n_exported = 0;
+	for (i = 0; i < variables_size; i++) {
+		if (variables[i].name != NULL
+		    && variables[i].flags & VAR_EXPORTED
+		    && variables[i].array == NULL) {
+			envp[n_exported++] = ptr;
+			ptr = stpcpy(ptr, variables[i].name);
+			*ptr++ = '=';
+			ptr = stpcpy(ptr, variables[i].value) + 1;
+		}
+	}
+	envp[n_exported] = NULL;
+	envp_generation = env_generation;
+
+	return envp;
+}
+
+void
+track_environment(int on)
+{
+	tracking = on;
+}
+
+const char *
+next_tracked_name(size_t *index)
+{
+	if (*index >= n_tracked_names) {
+		return NULL;
+	}
+	return tracked_names[(*index)++];
+}
+
+int
+next_var(size_t *index, const char **name, const char **value, int *flags)
+{
+	Variable *variable;
+
+	while (*index < variables_size) {
+		variable = &variables[(*index)++];
+		if (variable->name != NULL && variable->array == NULL) {
+			*name = variable->name;
+			*value = var_value(variable);
+			*flags = variable->flags & ~(VAR_STALE_VALUE
+						     | VAR_INHERITED
+						     | VAR_TRACKED);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// FNV-1a
+static unsigned int
+hash_name(const char *name, size_t len)
+{
+	unsigned int hash = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static Variable *
+find_slot(Variable * table, size_t size, const char *name, size_t len,
+	  unsigned int hash)
+{
+	size_t i = hash & (size - 1);
+
+	while (table[i].name != NULL) {
+		if (table[i].hash == hash
+		    && strncmp(table[i].name, name, len) == 0
+		    && table[i].name[len] == '\0') {
+			break;
+		}
+		i = (i + 1) & (size - 1);
+	}
+	return &table[i];
+}
+
+static void
+grow_variables()
+{
+	size_t i;
+	size_t new_size = variables_size * 2;
+	Variable *new_variables = calloc(new_size, sizeof(Variable));
+	Variable *slot;
+
+	if (new_variables == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	for (i = 0; i < variables_size; i++) {
+		if (variables[i].name != NULL) {
+			slot = find_slot(new_variables, new_size,
+					 variables[i].name,
+					 strlen(variables[i].name),
+					 variables[i].hash);
+			*slot = variables[i];
+		}
+	}
+	free(variables);
+	variables = new_variables;
+	variables_size = new_size;
+}
+
+static int
+is_valid_name(const char *name, size_t len)
+{
+	size_t i;
+
+	if (len == 0 || (name[0] >= '0' && name[0] <= '9')) {
+		return 0;
+	}
+	for (i = 0; i < len; i++) {
+		if (!(name[i] == '_' || (name[i] >= 'a' && name[i] <= 'z')
+		      || (name[i] >= 'A' && name[i] <= 'Z')
+		      || (name[i] >= '0' && name[i] <= '9'))) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static Variable *
+lookup_var(const char *name)
+{
+	size_t len = strlen(name);
+	Variable *variable = find_slot(variables, variables_size, name, len,
+				       hash_name(name, len));
+
+	if (variable->name == NULL) {
+		if (tracking) {
+			// Another environment may set it
+			track_name(name);
+		}
+		return NULL;
+	}
+	if (tracking) {
+		track_var(variable);
+	}
+	return variable;
+}
+
+// The new variable has no value yet
+static Variable *
+insert_var(const char *name, size_t len)
+{
+	unsigned int hash = hash_name(name, len);
+	Variable *variable;
+
+	variable = find_slot(variables, variables_size, name, len, hash);
+	if (variable->name != NULL) {
+		if (tracking) {
+			track_var(variable);
+		}
+		return variable;
+	}
+	// Keep the load factor under 3/4
+	if ((n_variables + 1) * 4 > variables_size * 3) {
+		grow_variables();
+		variable = find_slot(variables, variables_size, name, len,
+				     hash);
+	}
+	variable->name = strndup(name, len);
+	if (variable->name == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	variable->value = NULL;
+	variable->array = NULL;
+	variable->hash = hash;
+	variable->flags = 0;
+	n_variables++;
+	return variable;
+}
+
+static char *
+var_value(Variable * variable)
+{
+	if (variable->array != NULL) {
+		// An array expands to its first element
+		if (variable->array->len > 0
+		    && variable->array->elements[0] != NULL) {
+			return variable->array->elements[0];
+		}
+		return "";
+	}
+	if (variable->flags & VAR_STALE_VALUE) {
+		snprintf(variable->value, MAX_INTEGER_STRING, "%lld",
+			 variable->integer);
+		variable->flags &= ~VAR_STALE_VALUE;
+	}
+	return variable->value;
+}
+
+static void
+add_var_flags(Variable * variable, int flags)
+{
+	if ((variable->flags | flags) != variable->flags) {
+		variable->flags |= flags;
+		env_generation++;
+	}
+}
+
+static int
+set_var_len(const char *name, size_t len, const char *value, int flags)
+{
+	Variable *variable;
+	char *new_value;
+	long long integer = 0;
+
+	if (!is_valid_name(name, len)) {
+		return -1;
+	}
+
+	variable = insert_var(name, len);
+	if (flags & VAR_ARRAY) {
+		to_array(variable);
+	}
+	if (variable->array != NULL) {
+		set_element(variable->array, 0, value);
+		add_var_flags(variable, flags & ~VAR_INTEGER);
+		return 0;
+	}
+	if (variable->flags & VAR_INTEGER || flags & VAR_INTEGER) {
+		if (*value != '\0'
+		    && eval_math((char *)value, &integer, STDERR_FILENO) < 0) {
+			if (variable->value == NULL) {
+				// Never assigned
+				variable->value = strdup("");
+				if (variable->value == NULL) {
+					err(EXIT_FAILURE, "malloc failed");
+				}
+			}
+			return -2;
+		}
+		return set_var_int_len(name, len, integer, flags);
+	}
+
+	if (variable->value == NULL || strcmp(variable->value, value) != 0) {
+		// value could be the old value itself
+		new_value = strdup(value);
+		if (new_value == NULL) {
+			err(EXIT_FAILURE, "malloc failed");
+		}
+		free(variable->value);
+		variable->value = new_value;
+		if ((variable->flags | flags) & VAR_EXPORTED) {
+			env_generation++;
+		}
+	}
+	add_var_flags(variable, flags);
+	return 0;
+}
+
+static int
+set_var_int_len(const char *name, size_t len, long long value, int flags)
+{
+	Variable *variable;
+	char integer[MAX_INTEGER_STRING];
+
+	if (!is_valid_name(name, len)) {
+		return -1;
+	}
+
+	variable = insert_var(name, len);
+	if (variable->array != NULL) {
+		snprintf(integer, MAX_INTEGER_STRING, "%lld", value);
+		set_element(variable->array, 0, integer);
+		add_var_flags(variable, flags & ~VAR_INTEGER);
+		return 0;
+	}
+	if (!(variable->flags & VAR_INTEGER)) {
+		free(variable->value);
+		variable->value = malloc(MAX_INTEGER_STRING);
+		if (variable->value == NULL) {
+			err(EXIT_FAILURE, "malloc failed");
+		}
+		variable->integer = value;
+		variable->flags |= VAR_INTEGER | VAR_STALE_VALUE;
+		if ((variable->flags | flags) & VAR_EXPORTED) {
+			env_generation++;
+		}
+	} else if (variable->integer != value) {
+		variable->integer = value;
+		variable->flags |= VAR_STALE_VALUE;
+		if ((variable->flags | flags) & VAR_EXPORTED) {
+			env_generation++;
+		}
+	}
+	add_var_flags(variable, flags);
+	return 0;
+}
+
+// The value of a scalar variable becomes element 0
+static Array *
+to_array(Variable * variable)
+{
+	if (variable->array != NULL) {
+		return variable->array;
+	}
+
+	variable->array = malloc(sizeof(Array));
+	if (variable->array == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	memset(variable->array, 0, sizeof(Array));
+
+	if (variable->value != NULL) {
+		var_value(variable);
+		grow_array(variable->array, 1);
+		variable->array->elements[0] = variable->value;
+		variable->array->len = 1;
+		variable->array->n_set = 1;
+		variable->value = NULL;
+	}
+	if (variable->flags & VAR_EXPORTED) {
+		// Arrays are not in the environment
+		env_generation++;
+	}
+	variable->flags &= ~(VAR_INTEGER | VAR_STALE_VALUE);
+	variable->flags |= VAR_ARRAY;
+	return variable->array;
+}
+
+static void
+grow_array(Array * array, size_t size)
+{
+	size_t new_size = array->size == 0 ? ARRAY_INITIAL_SIZE : array->size;
+
+	if (size <= array->size) {
+		return;
+	}
+	while (new_size < size) {
+		new_size *= 2;
+	}
+	array->elements = realloc(array->elements, new_size * sizeof(char *));
+	if (array->elements == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	memset(array->elements + array->size, 0,
+	       (new_size - array->size) * sizeof(char *));
+	array->size = new_size;
+}
+
+static void
+free_element(Array * array, char *element)
+{
+	if (array->block == NULL || element < array->block
+	    || element >= array->block + array->block_size) {
+		free(element);
+	}
+}
+
+static void
+clear_array(Array * array)
+{
+	size_t i;
+
+	for (i = 0; i < array->len; i++) {
+		free_element(array, array->elements[i]);
+		array->elements[i] = NULL;
+	}
+	free(array->block);
+	array->block = NULL;
+	array->block_size = 0;
+	array->len = 0;
+	array->n_set = 0;
+}
+
+static void
+set_element(Array * array, size_t index, const char *value)
+{
+	char *new_value = strdup(value);
+
+	if (new_value == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	grow_array(array, index + 1);
+	if (array->elements[index] == NULL) {
+		array->n_set++;
+	} else {
+		free_element(array, array->elements[index]);
+	}
+	array->elements[index] = new_value;
+	if (index >= array->len) {
+		array->len = index + 1;
+	}
+}
+
+static int
+assign_element(const char *name, size_t len, const char *index,
+	       size_t index_len, const char *value)
+{
+	char *expression;
+	char *var_name;
+	size_t element;
+	int result = 0;
+
+	if (!is_valid_name(name, len)) {
+		return -1;
+	}
+
+	var_name = strndup(name, len);
+	expression = strndup(index, index_len);
+	if (var_name == NULL || expression == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	if (eval_array_index(var_name, expression, &element) < 0) {
+		result = -2;
+	} else {
+		set_array_element(var_name, element, value);
+	}
+	free(var_name);
+	free(expression);
+	return result;
+}
+
+// Variables set by mash itself never depend on the environment
+static void
+track_var(Variable * variable)
+{
+	if (variable->flags & VAR_INHERITED
+	    && !(variable->flags & VAR_TRACKED)) {
+		variable->flags |= VAR_TRACKED;
+		track_name(variable->name);
+	}
+}
+
+static void
+track_name(const char *name)
+{
+	char **new_names;
+	size_t i;
+
+	for (i = 0; i < n_tracked_names; i++) {
+		if (strcmp(tracked_names[i], name) == 0) {
+			return;
+		}
+	}
+	if (n_tracked_names == tracked_names_size) {
+		tracked_names_size = tracked_names_size == 0 ?
+		    TRACKED_NAMES_INITIAL_SIZE : tracked_names_size * 2;
+		new_names = realloc(tracked_names,
+				    tracked_names_size * sizeof(char *));
+		if (new_names == NULL) {
+			err(EXIT_FAILURE, "malloc failed");
+		}
+		tracked_names = new_names;
+	}
+	tracked_names[n_tracked_names] = strdup(name);
+	if (tracked_names[n_tracked_names] == NULL) {
+		err(EXIT_FAILURE, "malloc failed");
+	}
+	n_tracked_names++;
+}